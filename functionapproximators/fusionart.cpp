@@ -1,27 +1,54 @@
 #include "fusionart.h"
 
-#include <assert.h>
+#include <algorithm>
 #include <iostream>
+#include <limits>
+
+#include <assert.h>
+#include <alloca.h>
+#include <stdint.h>
+
+static const char fusionart_magic[4] = {'F', 'A', 'R', 'T'};
+static const uint32_t fusionart_format = 1;
+
+/**
+ * @brief Largest number of floats that load() accepts to allocate, 4 GB. Larger
+ *        sizes come from corrupted or malicious files.
+ */
+static const uint64_t fusionart_max_floats = uint64_t(1) << 30;
+
+/**
+ * @brief Parameters of a port, as stored by FusionART::save()
+ */
+struct PortHeader {
+    uint32_t size;
+    float weight;
+    float choice;
+    float vigilence;
+    float learning_rate;
+};
+
+FusionART::FusionART()
+: _num_patterns(0),
+  _version(0)
+{
+}
 
 void FusionART::addPort(Port *port)
 {
     _ports.push_back(port);
 }
 
-void FusionART::run(bool learn, unsigned int *pattern_index)
+unsigned int FusionART::numberOfPatterns() const
 {
-    // Use the inputs to compute the activations of all the patterns
-    for (unsigned int i=0; i<_pattern_activations.size(); ++i) {
-        _pattern_activations[i].index = i;
-        _pattern_activations[i].activation = 0.0f;
+    return _num_patterns;
+}
 
-        for (Port *port : _ports) {
-            _pattern_activations[i].activation +=
-                port->weight *
-                port->value.cwiseMin(port->patterns[i]).sum() /
-                (port->choice + port->patterns[i].sum());
-        }
-    }
+void FusionART::run(bool learn, unsigned int *pattern_index)
+{
+    // Use the inputs to compute the activations of all the patterns. The
+    // vigilence criterion is only checked when learning.
+    computeActivations(learn);
 
     // Pattern with the highest activation and a satisfied vigilence criterion
     unsigned int best_pattern = bestMatchingPattern(learn);
@@ -32,85 +59,329 @@ void FusionART::run(bool learn, unsigned int *pattern_index)
 
     // If learning is enabled, update the best pattern (or add a new one)
     if (learn) {
-        if (best_pattern == ~0) {
-            std::cout << "Creating new pattern " << _pattern_activations.size() << std::endl;
+        if (best_pattern == ~0u) {
+            std::cout << "Creating new pattern " << _num_patterns << std::endl;
 
-            // No existing pattern matched, create a new one
-            Activation act;
+            // No existing pattern matched, create a new one exactly matching
+            // the values on the ports
+            best_pattern = _num_patterns;
 
-            best_pattern = _pattern_activations.size();
-            act.index = best_pattern;
-            act.activation = 0.0f;
-
-            _pattern_activations.push_back(act);
-
-            for (Port *port : _ports) {
-                // New pattern exactly matching the value on the port
-                port->patterns.push_back(port->value);
-            }
+            addPattern();
         } else {
             // Update the pattern
             for (Port *port : _ports) {
-                Eigen::ArrayXf &pattern = port->patterns[best_pattern];
+                auto pattern = port->patterns.col(best_pattern);
 
                 pattern =
                     (1.0f - port->learning_rate) * pattern +
                     port->learning_rate * port->value.cwiseMin(pattern);
+
+                port->pattern_sums(best_pattern) = pattern.sum();
             }
+
+            _pattern_versions[best_pattern] = ++_version;
         }
     }
 
     // Adjust the output of the ports
-    if (best_pattern != ~0) {
+    if (best_pattern != ~0u) {
         for (Port *port : _ports) {
-            port->value = port->value.cwiseMin(port->patterns[best_pattern]);
+            port->value = port->value.cwiseMin(port->patterns.col(best_pattern));
+        }
+    }
+}
+
+void FusionART::runOneHot(const Port *port, const Port *output_port, std::vector<Eigen::ArrayXf> &outputs)
+{
+    unsigned int count = port->value.rows();
+
+    outputs.resize(count);
+
+    if (_num_patterns == 0) {
+        // No pattern, run() would leave the ports untouched
+        for (unsigned int i=0; i<count; ++i) {
+            outputs[i] = output_port->value;
+        }
+
+        return;
+    }
+
+    // Activations due to all the ports but the one-hot one
+    computeActivations(false, port);
+
+    // |e_i ^ pattern| = min(1, pattern(i)), so the contribution of the one-hot
+    // port to the activations is row i of its pattern matrix, scaled per pattern
+    Eigen::ArrayXf scale = port->weight / (port->choice + port->pattern_sums.head(_num_patterns));
+
+    for (unsigned int i=0; i<count; ++i) {
+        unsigned int best_pattern;
+
+        (_activations +
+            port->patterns.row(i).head(_num_patterns).transpose().min(1.0f) * scale
+        ).maxCoeff(&best_pattern);
+
+        outputs[i] = output_port->value.cwiseMin(output_port->patterns.col(best_pattern));
+    }
+}
+
+void FusionART::computeActivations(bool all_ports, const Port *excluded)
+{
+    _activations.setZero(_num_patterns);
+
+    if (_num_patterns == 0) {
+        return;
+    }
+
+    for (Port *port : _ports) {
+        if ((port->weight == 0.0f && !all_ports) || port == excluded) {
+            // This port does not contribute to the activations
+            continue;
+        }
+
+        // Fuzzy AND between the value of the port and all its patterns, in
+        // one pass over the contiguous pattern matrix. Each pattern is a
+        // contiguous column, so min and sum are vectorized by Eigen.
+        const Eigen::ArrayXf &value = port->value;
+
+        port->matches.resize(_num_patterns);
+
+        for (unsigned int i=0; i<_num_patterns; ++i) {
+            port->matches(i) = port->patterns.col(i).min(value).sum();
+        }
+
+        if (port->weight != 0.0f) {
+            _activations +=
+                port->weight * port->matches /
+                (port->choice + port->pattern_sums.head(_num_patterns));
         }
     }
 }
 
+void FusionART::addPattern()
+{
+    unsigned int capacity = _ports.size() > 0 ? _ports[0]->patterns.cols() : 0;
+
+    for (Port *port : _ports) {
+        if (_num_patterns == capacity) {
+            // Grow the pattern matrices geometrically, so that adding a pattern
+            // takes amortized constant time
+            unsigned int new_capacity = std::max(16u, 2 * capacity);
+
+            port->patterns.conservativeResize(port->value.rows(), new_capacity);
+            port->pattern_sums.conservativeResize(new_capacity);
+        }
+
+        port->patterns.col(_num_patterns) = port->value;
+        port->pattern_sums(_num_patterns) = port->value.sum();
+    }
+
+    _pattern_versions.push_back(++_version);
+    _num_patterns += 1;
+}
+
 unsigned int FusionART::bestMatchingPattern(bool check_vigilence)
 {
-    // Sort the pattern activations by decreasing activation so that trying one
-    // pattern then another takes linear time (instead of quadratic time). This
-    // operation is O(n*log n), which is also under O(n²).
-    std::sort(
-        _pattern_activations.begin(),
-        _pattern_activations.end(),
-        [](const Activation &a, const Activation &b) {
-            return a.activation > b.activation;
+    unsigned int best_pattern = ~0;
+
+    if (_num_patterns == 0) {
+        return best_pattern;
+    }
+
+    if (!check_vigilence) {
+        // Any pattern is accepted, the best one is simply the argmax
+        _activations.maxCoeff(&best_pattern);
+
+        return best_pattern;
+    }
+
+    // The matches of all the patterns are already known, so checking the
+    // vigilence criterion of a pattern is only a few comparisons. The pattern
+    // with the highest activation among the ones that satisfy the criterion
+    // is found in one O(n) pass, without sorting the activations.
+    float *thresholds = (float *)alloca(_ports.size() * sizeof(float));
+    float best_activation = -std::numeric_limits<float>::infinity();
+
+    for (std::size_t p=0; p<_ports.size(); ++p) {
+        thresholds[p] = _ports[p]->vigilence * _ports[p]->value.sum();
+    }
+
+    for (unsigned int i=0; i<_num_patterns; ++i) {
+        if (_activations(i) <= best_activation) {
+            continue;
         }
-    );
 
-    // Try to find a pattern whose vigilence criterion matches
-    for (unsigned int i=0; i<_pattern_activations.size(); ++i) {
-        unsigned int pattern_index = _pattern_activations[i].index;
+        // Check that the vigilence criterion is satisfied for all the ports
         bool ok = true;
 
-        if (check_vigilence) {
-            // Check that the vigilence criterion is satisfied for all the ports
-            for (Port *port : _ports) {
-                float m = port->value.cwiseMin(port->patterns[pattern_index]).sum();
-
-                if (m < port->vigilence * port->value.sum()) {
-                    ok = false;
-                    break;
-                }
+        for (std::size_t p=0; p<_ports.size(); ++p) {
+            if (_ports[p]->matches(i) < thresholds[p]) {
+                ok = false;
+                break;
             }
         }
 
         if (ok) {
-            return pattern_index;
+            best_pattern = i;
+            best_activation = _activations(i);
         }
     }
 
-    return ~0;
+    return best_pattern;
 }
 
 void FusionART::copyFrom(const FusionART &other)
 {
-    _pattern_activations = other._pattern_activations;
+    // Patterns having the same version in both models are identical, only
+    // copy the ones that have been created or modified in other.
+    _pattern_versions.resize(other._num_patterns, 0);
 
-    for (std::size_t i=0; i<_ports.size(); ++i) {
-        _ports[i]->patterns = other._ports[i]->patterns;
+    for (std::size_t p=0; p<_ports.size(); ++p) {
+        Port *port = _ports[p];
+        const Port *other_port = other._ports[p];
+
+        if (port->patterns.cols() < other_port->patterns.cols()) {
+            port->patterns.conservativeResize(other_port->patterns.rows(), other_port->patterns.cols());
+            port->pattern_sums.conservativeResize(other_port->pattern_sums.rows());
+        }
+
+        for (unsigned int i=0; i<other._num_patterns; ++i) {
+            if (i >= _num_patterns || _pattern_versions[i] != other._pattern_versions[i]) {
+                port->patterns.col(i) = other_port->patterns.col(i);
+                port->pattern_sums(i) = other_port->pattern_sums(i);
+            }
+        }
+    }
+
+    for (unsigned int i=0; i<other._num_patterns; ++i) {
+        _pattern_versions[i] = other._pattern_versions[i];
     }
+
+    // Modifications made after this copy must have versions that other has
+    // never given to any pattern
+    _num_patterns = other._num_patterns;
+    _version = std::max(_version, other._version);
+}
+
+bool FusionART::save(std::ostream &stream) const
+{
+    uint32_t num_ports = _ports.size();
+    uint32_t num_patterns = _num_patterns;
+
+    stream.write(fusionart_magic, sizeof(fusionart_magic));
+    stream.write((const char *)&fusionart_format, sizeof(fusionart_format));
+    stream.write((const char *)&num_ports, sizeof(num_ports));
+    stream.write((const char *)&num_patterns, sizeof(num_patterns));
+
+    for (Port *port : _ports) {
+        PortHeader header;
+
+        header.size = port->value.rows();
+        header.weight = port->weight;
+        header.choice = port->choice;
+        header.vigilence = port->vigilence;
+        header.learning_rate = port->learning_rate;
+
+        stream.write((const char *)&header, sizeof(header));
+    }
+
+    // The first _num_patterns columns of a pattern matrix are contiguous
+    for (Port *port : _ports) {
+        stream.write((const char *)port->patterns.data(), port->patterns.rows() * _num_patterns * sizeof(float));
+        stream.write((const char *)port->pattern_sums.data(), _num_patterns * sizeof(float));
+    }
+
+    return stream.good();
+}
+
+bool FusionART::load(std::istream &stream)
+{
+    char magic[sizeof(fusionart_magic)];
+    uint32_t format;
+    uint32_t num_ports;
+    uint32_t num_patterns;
+
+    stream.read(magic, sizeof(magic));
+    stream.read((char *)&format, sizeof(format));
+    stream.read((char *)&num_ports, sizeof(num_ports));
+    stream.read((char *)&num_patterns, sizeof(num_patterns));
+
+    if (!stream ||
+        !std::equal(magic, magic + sizeof(magic), fusionart_magic) ||
+        format != fusionart_format ||
+        num_ports != _ports.size()) {
+        return false;
+    }
+
+    std::vector<PortHeader> headers(num_ports);
+
+    stream.read((char *)headers.data(), num_ports * sizeof(PortHeader));
+
+    if (!stream) {
+        return false;
+    }
+
+    // Check the sizes before allocating anything. They are bounded, and must
+    // fit in what remains of the stream when its length can be known.
+    uint64_t num_floats = 0;
+
+    for (uint32_t p=0; p<num_ports; ++p) {
+        num_floats += (uint64_t(headers[p].size) + 1) * uint64_t(num_patterns);
+
+        if (num_floats > fusionart_max_floats) {
+            return false;
+        }
+    }
+
+    std::streampos position = stream.tellg();
+
+    if (position != std::streampos(-1)) {
+        stream.seekg(0, std::ios::end);
+        std::streampos end = stream.tellg();
+        stream.seekg(position);
+
+        if (!stream || end == std::streampos(-1) || uint64_t(end - position) < num_floats * sizeof(float)) {
+            return false;
+        }
+    }
+
+    // Read the patterns in temporary matrices, so that a truncated stream
+    // leaves the model untouched
+    std::vector<Eigen::ArrayXXf> patterns(num_ports);
+    std::vector<Eigen::ArrayXf> pattern_sums(num_ports);
+
+    for (uint32_t p=0; p<num_ports; ++p) {
+        patterns[p].resize(headers[p].size, num_patterns);
+        pattern_sums[p].resize(num_patterns);
+
+        stream.read((char *)patterns[p].data(), patterns[p].size() * sizeof(float));
+        stream.read((char *)pattern_sums[p].data(), pattern_sums[p].size() * sizeof(float));
+    }
+
+    if (!stream) {
+        return false;
+    }
+
+    for (uint32_t p=0; p<num_ports; ++p) {
+        Port *port = _ports[p];
+        const PortHeader &header = headers[p];
+
+        port->value.resize(header.size);
+        port->weight = header.weight;
+        port->choice = header.choice;
+        port->vigilence = header.vigilence;
+        port->learning_rate = header.learning_rate;
+
+        port->patterns.swap(patterns[p]);
+        port->pattern_sums.swap(pattern_sums[p]);
+    }
+
+    // Every loaded pattern gets a new version, as its content has changed
+    _num_patterns = num_patterns;
+    _pattern_versions.resize(num_patterns);
+
+    for (uint32_t i=0; i<num_patterns; ++i) {
+        _pattern_versions[i] = ++_version;
+    }
+
+    return true;
 }
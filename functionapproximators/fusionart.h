@@ -25,6 +25,7 @@
 
 #include <Eigen/Dense>
 #include <vector>
+#include <iostream>
 
 /**
  * @brief Fusion ART (Adaptive Resonance Theory) model
@@ -56,9 +57,13 @@ class FusionART
                 {}
 
             private:
-                std::vector<Eigen::ArrayXf> patterns; /*!< @brief List of patterns, all the ports having the same number of patterns */
+                Eigen::ArrayXXf patterns;       /*!< @brief Patterns of this port, one per column, stored in one contiguous block. Only the first numberOfPatterns() columns are used. */
+                Eigen::ArrayXf pattern_sums;    /*!< @brief Cached sum of every pattern */
+                Eigen::ArrayXf matches;         /*!< @brief |value ^ pattern| for every pattern, computed by run() */
         };
 
+        FusionART();
+
         /**
          * @brief Add a port to this ART model
          *
@@ -76,13 +81,93 @@ class FusionART
          */
         void run(bool learn, unsigned int *pattern_index = nullptr);
 
+        /**
+         * @brief Run the model without learning for every one-hot value of a port
+         *
+         * This is equivalent to putting e_i in @p port and calling run(false)
+         * for every i, but the activations due to the other ports are computed
+         * only once. The contribution of @p port to the activation of a pattern
+         * is then a single element of the pattern (patterns being between 0
+         * and 1), so all the values of i are handled in one scan of the patterns.
+         *
+         * @param port Port that receives the one-hot vectors. Its value is not used.
+         * @param output_port Port whose output is returned
+         * @param outputs Receives, for each i, the value that @p output_port
+         *                would have after run(false) with e_i in @p port.
+         *
+         * @note The values of the ports are not modified.
+         */
+        void runOneHot(const Port *port, const Port *output_port, std::vector<Eigen::ArrayXf> &outputs);
+
         /**
          * @brief Copy all the patterns and data from another model, that must
          *        have the same number of ports.
+         *
+         * Every pattern has a version, changed each time it is created or
+         * updated. Only the patterns whose version differs from the one in
+         * this model are copied, which makes synchronizing a learning model
+         * with the prediction model it was copied from cost only the patterns
+         * that have changed since the last copy.
+         *
+         * @note @p other is only read, and only its patterns are accessed, so
+         *       run() can be called concurrently on @p other without learning.
          */
         void copyFrom(const FusionART &other);
 
+        /**
+         * @brief Number of patterns (categories) learned by the model
+         */
+        unsigned int numberOfPatterns() const;
+
+        /**
+         * @brief Write the patterns and the parameters of the ports to a binary
+         *        stream.
+         *
+         * The stream contains a header, the size and parameters of every port,
+         * then, for every port, its pattern matrix (column-major, one column
+         * per pattern) followed by the sums of the patterns. Everything is
+         * stored as native 32-bit words, 4-byte aligned, so that the matrices
+         * could be used in place with Eigen::Map. load() nevertheless reads
+         * the file into memory instead of mapping it, because the patterns
+         * of a model grow when it learns and need storage owned by the model.
+         *
+         * @return False if the stream could not be written.
+         */
+        bool save(std::ostream &stream) const;
+
+        /**
+         * @brief Replace the patterns of this model with the ones stored in a
+         *        stream written by save().
+         *
+         * The model must have the same number of ports as the saved one. The
+         * parameters of the ports are restored and their values resized.
+         *
+         * The sizes read from the stream are checked before anything is
+         * allocated: they must be below a sanity limit and, if the stream is
+         * seekable, fit in the remaining bytes of the stream.
+         *
+         * @return False if the stream is not a valid FusionART stream or does
+         *         not match the ports of this model. The model is left unchanged
+         *         in this case.
+         */
+        bool load(std::istream &stream);
+
     private:
+        /**
+         * @brief Compute the activations of all the patterns, and the fuzzy AND
+         *        between the ports and their patterns.
+         *
+         * @param all_ports Also compute the matches of ports having a null weight,
+         *                  that are needed when the vigilence criterion is checked.
+         * @param excluded Port that is not taken into account, if not nullptr
+         */
+        void computeActivations(bool all_ports, const Port *excluded = nullptr);
+
+        /**
+         * @brief Add a pattern equal to the current values of the ports
+         */
+        void addPattern();
+
         /**
          * @brief Return the pattern with the highest activation and a satisfied
          *        vigilence criterion.
@@ -92,13 +177,11 @@ class FusionART
         unsigned int bestMatchingPattern(bool check_vigilence);
 
     private:
-        struct Activation {
-            unsigned int index;
-            float activation;
-        };
-
         std::vector<Port *> _ports;                     /*!< @brief List of ports of this model */
-        std::vector<Activation> _pattern_activations;   /*!< @brief Activations of the different patterns */
+        Eigen::ArrayXf _activations;                    /*!< @brief Activations of the patterns, computed in one pass over the ports */
+        unsigned int _num_patterns;                     /*!< @brief Number of patterns stored in the ports */
+        std::vector<unsigned long long> _pattern_versions;  /*!< @brief Version of every pattern, used by copyFrom() to skip unchanged patterns */
+        unsigned long long _version;                    /*!< @brief Last version given to a pattern */
 };
 
 #endif
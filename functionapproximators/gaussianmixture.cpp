@@ -23,16 +23,74 @@
 #include "gaussianmixture.h"
 
 #include <algorithm>
+#include <numeric>
 #include <cmath>
+#include <limits>
+#include <functional>
 
 #include <alloca.h>
 
-#define NEW_VEC (float *)alloca(numberOfClusters() * sizeof(float))
+#define NEW_VEC(n) (float *)alloca((n) * sizeof(float))
 
-GaussianMixture::GaussianMixture(float var_initial, float novelty)
+/**
+ * @brief Number of clusters whose distances are computed by a single task of
+ *        the parallel loop
+ */
+static const unsigned int parallel_chunk_size = 64;
+
+/**
+ * @brief Minimum number of floating-point operations (approximately
+ *        clusters * D²) for the distances to be computed in parallel
+ */
+static const std::size_t min_parallel_work = 16384;
+
+/**
+ * @brief Replace the lower-triangular Cholesky factor @p L of A by the one of
+ *        A + xx', in O(D²) instead of the O(D³) of a full decomposition.
+ *
+ * @note @p x is used as scratch memory and is overwritten.
+ */
+static void choleskyRankUpdate(Eigen::MatrixXf &L, Eigen::VectorXf &x)
+{
+    int D = x.rows();
+
+    for (int k=0; k<D; ++k) {
+        // Givens rotation that zeroes x(k) against L(k, k)
+        float l = L(k, k);
+        float r = std::sqrt(l*l + x(k)*x(k));
+        float c = r / l;
+        float s = x(k) / l;
+        int rest = D - k - 1;
+
+        L(k, k) = r;
+
+        if (rest > 0) {
+            L.col(k).tail(rest) = (L.col(k).tail(rest) + s * x.tail(rest)) / c;
+            x.tail(rest) = c * x.tail(rest) - s * L.col(k).tail(rest);
+        }
+    }
+}
+
+GaussianMixture::GaussianMixture(float var_initial, float novelty, float prune_threshold)
 : _var_initial(var_initial),
-  _novelty(novelty)
+  _novelty(novelty),
+  _max_mahalanobis(-2.0f * std::log(novelty)),
+  _prune_threshold(prune_threshold),
+  _max_density_factor(0.0f),
+  _max_variance_bound(0.0f),
+  _sum_sprobabilities(0.0f),
+  _consolidate_cursor(0)
 {
+    if (prune_threshold > 0.0f) {
+        // Never prune clusters that may pass the novelty criterion
+        _cutoff_mahalanobis = std::max(-2.0f * std::log(prune_threshold), _max_mahalanobis);
+
+        // A new cluster covers about one cell in every direction
+        _cell_size = std::sqrt(_var_initial * _cutoff_mahalanobis);
+    } else {
+        _cutoff_mahalanobis = std::numeric_limits<float>::infinity();
+        _cell_size = 1.0f;
+    }
 }
 
 unsigned int GaussianMixture::numberOfClusters() const
@@ -40,69 +98,209 @@ unsigned int GaussianMixture::numberOfClusters() const
     return _weights.size();
 }
 
+void GaussianMixture::setParallelFor(const ParallelFor &parallel_for)
+{
+    _parallel_for = parallel_for;
+}
+
 
 float GaussianMixture::value(const Eigen::VectorXf &input) const
 {
-    float *probabilities = NEW_VEC;
-    float rs = 0.0f;
+    Eigen::VectorXf rs = Eigen::VectorXf::Zero(1);
+
+    values(input, rs);
+
+    return rs(0);
+}
+
+void GaussianMixture::values(const Eigen::VectorXf &input, Eigen::VectorXf &rs) const
+{
+    std::vector<unsigned int> clusters;
+    float *probabilities = NEW_VEC(numberOfClusters());
+
+    if (numberOfClusters() == 0) {
+        rs.setZero();
+        return;
+    }
+
+    candidateClusters(input, _cutoff_mahalanobis, clusters);
+    probabilitiesOfInputs(probabilities, clusters, input);
+
+    float cutoff = pruningCutoff(std::accumulate(probabilities, probabilities + clusters.size(), 0.0f));
+
+    if (cutoff > _cutoff_mahalanobis) {
+        // The pruned clusters may weigh too much compared to the candidates,
+        // look further. The candidates found with the first cutoff are part
+        // of the new ones, so the density that they give can only grow.
+        candidateClusters(input, cutoff, clusters);
+        probabilitiesOfInputs(probabilities, clusters, input);
+    }
+
+    if (std::accumulate(probabilities, probabilities + clusters.size(), 0.0f) < std::numeric_limits<float>::min()) {
+        // The input is far from every candidate cluster, use all of them so
+        // that the closest ones still give a value
+        clusters.resize(numberOfClusters());
+        std::iota(clusters.begin(), clusters.end(), 0);
+
+        probabilitiesOfInputs(probabilities, clusters, input);
+
+        if (std::accumulate(probabilities, probabilities + clusters.size(), 0.0f) < std::numeric_limits<float>::min()) {
+            // Even the closest clusters underflow, compute the probabilities
+            // in log-space and scale them so that the largest one is 1
+            mahalanobisDistances(probabilities, clusters, input);
+
+            for (std::size_t i=0; i<clusters.size(); ++i) {
+                unsigned int cluster = clusters[i];
+
+                probabilities[i] =
+                    std::log(_gaussian_normalizations[cluster] * _sprobabilities[cluster]) -
+                    0.5f * probabilities[i];
+            }
+
+            float max_log = *std::max_element(probabilities, probabilities + clusters.size());
+
+            for (std::size_t i=0; i<clusters.size(); ++i) {
+                probabilities[i] = std::exp(probabilities[i] - max_log);
+            }
+        }
+    }
+
+    probabilitiesOfClusters(probabilities, probabilities, clusters.size());
+
+    // A single density evaluation gives the values of all the outputs
+    rs = Eigen::VectorXf::Zero(_weights[0].rows());
+
+    for (std::size_t i=0; i<clusters.size(); ++i) {
+        rs += _weights[clusters[i]] * probabilities[i];
+    }
+}
+
+void GaussianMixture::consolidate(unsigned int max_clusters, unsigned int max_checks)
+{
+    std::vector<unsigned int> clusters;
+
+    // Merge the overlapping clusters, starting where the previous call stopped
+    for (unsigned int check=0; check<max_checks && check<numberOfClusters(); ++check) {
+        if (_consolidate_cursor >= numberOfClusters()) {
+            _consolidate_cursor = 0;
+        }
 
-    probabilitiesOfClusters(probabilities, input, NAN);
+        unsigned int cluster = _consolidate_cursor++;
 
-    for (std::size_t cluster=0; cluster<numberOfClusters(); ++cluster) {
-        rs += _weights[cluster] * probabilities[cluster];
+        candidateClusters(_means[cluster], _cutoff_mahalanobis, clusters);
+
+        for (unsigned int other : clusters) {
+            if (other != cluster && mahalanobisDistance(cluster, _means[other]) < _max_mahalanobis) {
+                // Only one merge per examined cluster, as merging renumbers clusters
+                mergeClusters(cluster, other);
+                break;
+            }
+        }
     }
 
-    return rs;
+    // Drop the least probable clusters if the budget is exceeded
+    if (numberOfClusters() > max_clusters) {
+        std::vector<unsigned int> order(numberOfClusters());
+        unsigned int excess = numberOfClusters() - max_clusters;
+
+        std::iota(order.begin(), order.end(), 0);
+        std::nth_element(order.begin(), order.begin() + excess, order.end(), [this](unsigned int a, unsigned int b) {
+            return _sprobabilities[a] < _sprobabilities[b];
+        });
+
+        // Remove the clusters by decreasing index, so that the last cluster,
+        // that replaces a removed one, is never one that still has to be removed.
+        order.resize(excess);
+        std::sort(order.begin(), order.end(), std::greater<unsigned int>());
+
+        for (unsigned int cluster : order) {
+            removeCluster(cluster);
+        }
+    }
+
+    // Merged and removed clusters may have held the largest density factor,
+    // tighten the bound
+    _max_density_factor = 0.0f;
+
+    for (unsigned int cluster=0; cluster<numberOfClusters(); ++cluster) {
+        updateDensityFactor(cluster);
+    }
 }
 
 void GaussianMixture::setValue(const Eigen::VectorXf &input, float value)
+{
+    setValues(input, Eigen::VectorXf::Constant(1, value));
+}
+
+void GaussianMixture::setValues(const Eigen::VectorXf &input, const Eigen::VectorXf &values)
 {
     int D = input.rows();
-    float sum_sp = numberOfClusters() == 0 ? 1.0f : std::accumulate(_sprobabilities.begin(), _sprobabilities.end(), 0.0f);
+    std::vector<unsigned int> clusters;
+
+    candidateClusters(input, _cutoff_mahalanobis, clusters);
 
     // If the probability of one cluster is above its novelty, an existing
-    // cluster can be reused.
+    // cluster can be reused. p(input|cluster) > normalization * novelty is
+    // equivalent to comparing the Mahalanobis distance to -2 log(novelty),
+    // which avoids an exp per cluster.
+    float *distances = NEW_VEC(clusters.size());
     bool create_new_cluster = true;
 
-    for (std::size_t cluster=0; cluster<numberOfClusters(); ++cluster) {
-        if (probabilityOfInput(cluster, input) > _gaussian_normalizations[cluster] * _novelty) {
+    mahalanobisDistances(distances, clusters, input);
+
+    for (std::size_t i=0; i<clusters.size(); ++i) {
+        if (distances[i] < _max_mahalanobis) {
             create_new_cluster = false;
-            break;
         }
     }
 
     if (create_new_cluster) {
-        Eigen::MatrixXf covariance = Eigen::MatrixXf::Identity(D, D) * _var_initial;
-
-        _inv_2pi_d = 1.0f / (std::pow(2 * 3.14159265, float(D) * 0.5f));
+        unsigned int cluster = numberOfClusters();
 
-        // Create a new cluster
+        // Create a new cluster, whose covariance is var_initial * I. Its Cholesky
+        // factor is therefore sqrt(var_initial) * I.
         _means.push_back(input);
-        _covariances.push_back(covariance);
-        _inv_covariances.push_back(covariance.inverse());
-        _weights.push_back(value);
-        _probabilities.push_back(1.0f / sum_sp);
+        _cholesky.push_back(Eigen::MatrixXf::Identity(D, D) * std::sqrt(_var_initial));
+        _weights.push_back(values);
         _sprobabilities.push_back(1.0f);
-        _gaussian_normalizations.push_back(_inv_2pi_d / std::sqrt(covariance.norm()));
+        _gaussian_normalizations.push_back(gaussianNormalization(cluster));
+        _variance_bounds.push_back(0.0f);
+        _cells.push_back(Cell());
 
-        // Adjust the probabilities of the other clusters
-        float inv_sum_sp = 1.0f / (sum_sp + 1.0f);
+        _sum_sprobabilities += 1.0f;
 
-        for (std::size_t cluster=0; cluster<numberOfClusters()-1; ++cluster) {
-            _probabilities[cluster] = _sprobabilities[cluster] * inv_sum_sp;
-        }
+        updateDensityFactor(cluster);
+        updateVarianceBound(cluster);
+        placeCluster(cluster);
     } else {
         // Probabilities of the clusters given the inputs
-        float *cluster_probabilities = NEW_VEC;
-        float *input_probabilities = NEW_VEC;
+        float *cluster_probabilities = NEW_VEC(numberOfClusters());
+        float *input_probabilities = NEW_VEC(numberOfClusters());
+        float inv_sum_sp = 1.0f / _sum_sprobabilities;
+
+        for (std::size_t i=0; i<clusters.size(); ++i) {
+            unsigned int cluster = clusters[i];
+
+            input_probabilities[i] =
+                _gaussian_normalizations[cluster] * std::exp(-0.5f * distances[i]) *
+                _sprobabilities[cluster] * inv_sum_sp;
+        }
+
+        float cutoff = pruningCutoff(std::accumulate(input_probabilities, input_probabilities + clusters.size(), 0.0f));
+
+        if (cutoff > _cutoff_mahalanobis) {
+            // The pruned clusters may weigh too much, look further
+            candidateClusters(input, cutoff, clusters);
+            probabilitiesOfInputs(input_probabilities, clusters, input);
+        }
 
-        probabilitiesOfInputs(input_probabilities, input, value);
-        probabilitiesOfClusters(cluster_probabilities, input_probabilities);
+        probabilitiesOfClusters(cluster_probabilities, input_probabilities, clusters.size());
 
         // Find the cluster with the greatest probability
-        auto it = std::max_element(input_probabilities, input_probabilities + numberOfClusters());
-        int cluster = std::distance(input_probabilities, it);
-        float proba = cluster_probabilities[cluster];
+        auto it = std::max_element(input_probabilities, input_probabilities + clusters.size());
+        int index = std::distance(input_probabilities, it);
+        int cluster = clusters[index];
+        float proba = cluster_probabilities[index];
 
         // Update the cluster according to
         // "An Incremental Probabilistic Neural Network for Regression and Reinforcement Learning Tasks"
@@ -113,54 +311,377 @@ void GaussianMixture::setValue(const Eigen::VectorXf &input, float value)
         Eigen::VectorXf delta_prev_mean = delta_mean - delta_mean_factor;
 
         _sprobabilities[cluster] = new_sproba;
-        _probabilities[cluster] = new_sproba / (sum_sp + proba);
+        _sum_sprobabilities += proba;
         _means[cluster] += delta_mean_factor;
-        _weights[cluster] += learning_factor * (value - _weights[cluster]);
-        _covariances[cluster] = _covariances[cluster] +
-                                delta_mean_factor * delta_mean_factor.transpose() +
-                                learning_factor * (
-                                    delta_prev_mean * delta_prev_mean.transpose() -
-                                    _covariances[cluster]
-                                );
-        _inv_covariances[cluster] = _covariances[cluster].inverse();
-        _gaussian_normalizations[cluster] = _inv_2pi_d / std::sqrt(_covariances[cluster].norm());
+        _weights[cluster] += learning_factor * (values - _weights[cluster]);
+
+        // The covariance update C + dmf*dmf' + lf*(dpm*dpm' - C) can be rewritten
+        // (1 - lf)*C + dmf*dmf' + (sqrt(lf)*dpm)*(sqrt(lf)*dpm)'. The Cholesky
+        // factor is scaled by sqrt(1 - lf) and receives two rank-one updates.
+        Eigen::MatrixXf &L = _cholesky[cluster];
+
+        delta_prev_mean *= std::sqrt(learning_factor);
+
+        L *= std::sqrt(1.0f - learning_factor);
+        choleskyRankUpdate(L, delta_mean_factor);
+        choleskyRankUpdate(L, delta_prev_mean);
+
+        _gaussian_normalizations[cluster] = gaussianNormalization(cluster);
+
+        // The cluster may have moved to another cell and changed shape
+        updateDensityFactor(cluster);
+        updateVarianceBound(cluster);
+        placeCluster(cluster);
     }
 }
 
 float GaussianMixture::probabilityOfInput(unsigned int cluster, const Eigen::VectorXf &input) const
 {
-    return _gaussian_normalizations[cluster] * std::exp(
-        (-0.5f * (
-            (input - _means[cluster]).transpose() *
-            _inv_covariances[cluster] *
-            (input - _means[cluster])
-        ))(0)
+    return _gaussian_normalizations[cluster] * std::exp(-0.5f * mahalanobisDistance(cluster, input));
+}
+
+float GaussianMixture::mahalanobisDistance(unsigned int cluster, const Eigen::VectorXf &input) const
+{
+    // (x - mu)' C^-1 (x - mu) = |L^-1 (x - mu)|², L^-1 being applied by forward
+    // substitution.
+    Eigen::VectorXf y = _cholesky[cluster].triangularView<Eigen::Lower>().solve(input - _means[cluster]);
+
+    return y.squaredNorm();
+}
+
+void GaussianMixture::mahalanobisDistances(float *out, const std::vector<unsigned int> &clusters, const Eigen::VectorXf &input) const
+{
+    std::size_t count = clusters.size();
+    std::size_t work = count * std::size_t(input.rows() * input.rows());
+
+    if (!_parallel_for || work < min_parallel_work) {
+        for (std::size_t i=0; i<count; ++i) {
+            out[i] = mahalanobisDistance(clusters[i], input);
+        }
+
+        return;
+    }
+
+    // Every task computes the distances of a chunk of clusters. The clusters
+    // are only read, and every task writes its own part of out.
+    unsigned int num_chunks = (count + parallel_chunk_size - 1) / parallel_chunk_size;
+
+    _parallel_for(num_chunks, [&](unsigned int chunk) {
+        std::size_t end = std::min(count, std::size_t(chunk + 1) * parallel_chunk_size);
+
+        for (std::size_t i=std::size_t(chunk) * parallel_chunk_size; i<end; ++i) {
+            out[i] = mahalanobisDistance(clusters[i], input);
+        }
+    });
+}
+
+float GaussianMixture::gaussianNormalization(unsigned int cluster) const
+{
+    // |C| = prod(diag(L))², so 1/sqrt(|C|) = exp(-sum(log(diag(L))))
+    return std::exp(-_cholesky[cluster].diagonal().array().log().sum());
+}
+
+float GaussianMixture::varianceBound(unsigned int cluster) const
+{
+    // lambda_max(LL') = |L|_2² <= |L|_1 * |L|_inf, which is exact for the
+    // initial diagonal clusters and costs O(D²)
+    Eigen::MatrixXf abs_l = _cholesky[cluster].cwiseAbs();
+
+    return abs_l.colwise().sum().maxCoeff() * abs_l.rowwise().sum().maxCoeff();
+}
+
+GaussianMixture::Cell GaussianMixture::cellOf(const Eigen::VectorXf &point) const
+{
+    Cell cell(point.rows());
+
+    for (int d=0; d<point.rows(); ++d) {
+        cell[d] = int(std::floor(point(d) / _cell_size));
+    }
+
+    return cell;
+}
+
+void GaussianMixture::placeCluster(unsigned int cluster)
+{
+    if (std::isinf(_cutoff_mahalanobis)) {
+        // No pruning, the grid is not used
+        return;
+    }
+
+    Cell cell = cellOf(_means[cluster]);
+
+    if (cell == _cells[cluster]) {
+        return;
+    }
+
+    unplaceCluster(cluster);
+
+    _grid[cell].push_back(cluster);
+    _cells[cluster] = cell;
+}
+
+void GaussianMixture::unplaceCluster(unsigned int cluster)
+{
+    Cell &cell = _cells[cluster];
+
+    if (cell.size() == 0) {
+        return;
+    }
+
+    auto it = _grid.find(cell);
+    std::vector<unsigned int> &clusters = it->second;
+
+    clusters.erase(std::find(clusters.begin(), clusters.end(), cluster));
+
+    if (clusters.size() == 0) {
+        _grid.erase(it);
+    }
+
+    cell.clear();
+}
+
+void GaussianMixture::removeCluster(unsigned int cluster)
+{
+    unsigned int last = numberOfClusters() - 1;
+    float bound = _variance_bounds[cluster];
+
+    unplaceCluster(cluster);
+    _sum_sprobabilities -= _sprobabilities[cluster];
+
+    if (cluster != last) {
+        // Move the last cluster in place of the removed one
+        Cell cell = _cells[last];
+
+        unplaceCluster(last);
+
+        _gaussian_normalizations[cluster] = _gaussian_normalizations[last];
+        _sprobabilities[cluster] = _sprobabilities[last];
+        std::swap(_weights[cluster], _weights[last]);
+        _variance_bounds[cluster] = _variance_bounds[last];
+        std::swap(_cholesky[cluster], _cholesky[last]);
+        std::swap(_means[cluster], _means[last]);
+
+        if (cell.size() != 0) {
+            _grid[cell].push_back(cluster);
+            _cells[cluster] = cell;
+        }
+    }
+
+    _gaussian_normalizations.pop_back();
+    _sprobabilities.pop_back();
+    _weights.pop_back();
+    _variance_bounds.pop_back();
+    _cholesky.pop_back();
+    _means.pop_back();
+    _cells.pop_back();
+
+    if (bound >= _max_variance_bound) {
+        _max_variance_bound = (_variance_bounds.size() == 0 ?
+            0.0f :
+            *std::max_element(_variance_bounds.begin(), _variance_bounds.end()));
+    }
+}
+
+unsigned int GaussianMixture::mergeClusters(unsigned int cluster, unsigned int other)
+{
+    // Moment matching: the merged gaussian has the mean and covariance of the
+    // mixture of the two clusters, weighted by their sp(i)
+    float sp = _sprobabilities[cluster] + _sprobabilities[other];
+    float a = _sprobabilities[cluster] / sp;
+    float b = _sprobabilities[other] / sp;
+
+    Eigen::VectorXf mean = a * _means[cluster] + b * _means[other];
+    Eigen::VectorXf delta_a = _means[cluster] - mean;
+    Eigen::VectorXf delta_b = _means[other] - mean;
+    Eigen::MatrixXf covariance =
+        a * (_cholesky[cluster] * _cholesky[cluster].transpose() + delta_a * delta_a.transpose()) +
+        b * (_cholesky[other] * _cholesky[other].transpose() + delta_b * delta_b.transpose());
+
+    // Merging is rare, a full O(D³) decomposition is acceptable here
+    _cholesky[cluster] = covariance.llt().matrixL();
+    _means[cluster] = mean;
+    _weights[cluster] = a * _weights[cluster] + b * _weights[other];
+    _gaussian_normalizations[cluster] = gaussianNormalization(cluster);
+
+    // other is removed and its sp is given to cluster
+    _sprobabilities[cluster] = sp;
+    _sum_sprobabilities += _sprobabilities[other];
+
+    updateDensityFactor(cluster);
+    updateVarianceBound(cluster);
+    placeCluster(cluster);
+    removeCluster(other);
+
+    return (cluster == numberOfClusters() ? other : cluster);
+}
+
+void GaussianMixture::updateVarianceBound(unsigned int cluster)
+{
+    float old_bound = _variance_bounds[cluster];
+    float bound = varianceBound(cluster);
+
+    _variance_bounds[cluster] = bound;
+
+    if (bound >= _max_variance_bound) {
+        _max_variance_bound = bound;
+    } else if (old_bound >= _max_variance_bound) {
+        // The largest cluster has shrunk, look for the new largest one
+        _max_variance_bound = *std::max_element(_variance_bounds.begin(), _variance_bounds.end());
+    }
+}
+
+void GaussianMixture::candidateClusters(const Eigen::VectorXf &input, float cutoff, std::vector<unsigned int> &clusters) const
+{
+    clusters.clear();
+
+    if (std::isinf(cutoff)) {
+        // No pruning, consider all the clusters
+        clusters.resize(numberOfClusters());
+        std::iota(clusters.begin(), clusters.end(), 0);
+        return;
+    }
+
+    if (numberOfClusters() == 0) {
+        return;
+    }
+
+    float sq_radius = cutoff * _max_variance_bound;
+    float cell_radius = std::ceil(std::sqrt(sq_radius) / _cell_size);
+    Cell center = cellOf(input);
+    std::size_t D = center.size();
+
+    // Enumerate the cells around center if there are less of them than occupied
+    // cells. In high dimensions, there are too many neighbouring cells, and
+    // the occupied cells are scanned instead (each costs O(D) instead of the
+    // O(D²) of a Mahalanobis distance).
+    bool enumerate = (cell_radius < 1000.0f);
+    std::size_t neighbourhood = 1;
+    int r = int(cell_radius);
+
+    for (std::size_t d=0; d<D && enumerate; ++d) {
+        neighbourhood *= 2*r + 1;
+        enumerate = (neighbourhood <= _grid.size());
+    }
+
+    if (enumerate) {
+        Cell offset(D, -r);
+        Cell cell(D);
+
+        while (true) {
+            for (std::size_t d=0; d<D; ++d) {
+                cell[d] = center[d] + offset[d];
+            }
+
+            auto it = _grid.find(cell);
+
+            if (it != _grid.end()) {
+                clusters.insert(clusters.end(), it->second.begin(), it->second.end());
+            }
+
+            // Next offset, incremented like an odometer
+            std::size_t d = 0;
+
+            while (d < D && ++offset[d] > r) {
+                offset[d] = -r;
+                ++d;
+            }
+
+            if (d == D) {
+                break;
+            }
+        }
+    } else {
+        for (const auto &entry : _grid) {
+            const Cell &cell = entry.first;
+            float sq_distance = 0.0f;
+
+            // Squared distance between input and the box of the cell
+            for (std::size_t d=0; d<D && sq_distance <= sq_radius; ++d) {
+                float low = float(cell[d]) * _cell_size;
+                float high = low + _cell_size;
+                float x = input(d);
+                float delta = (x < low ? low - x : (x > high ? x - high : 0.0f));
+
+                sq_distance += delta * delta;
+            }
+
+            if (sq_distance <= sq_radius) {
+                clusters.insert(clusters.end(), entry.second.begin(), entry.second.end());
+            }
+        }
+    }
+}
+
+float GaussianMixture::pruningCutoff(float kept_mass) const
+{
+    if (std::isinf(_cutoff_mahalanobis)) {
+        return _cutoff_mahalanobis;
+    }
+
+    // A cluster farther than cutoff contributes at most
+    // normalization * sp / sum(sp) * exp(-0.5 * cutoff) to the density. The
+    // clusters beyond the returned cutoff therefore contribute at most
+    // prune_threshold * kept_mass in total.
+    float max_pruned_mass = float(numberOfClusters()) * _max_density_factor / _sum_sprobabilities;
+    float ratio = _prune_threshold * kept_mass / max_pruned_mass;
+
+    if (!(ratio > 0.0f)) {
+        // Nothing is known about the density, consider all the clusters
+        return std::numeric_limits<float>::infinity();
+    }
+
+    return std::max(_cutoff_mahalanobis, -2.0f * std::log(ratio));
+}
+
+void GaussianMixture::updateDensityFactor(unsigned int cluster)
+{
+    _max_density_factor = std::max(
+        _max_density_factor,
+        _gaussian_normalizations[cluster] * _sprobabilities[cluster]
     );
 }
 
-void GaussianMixture::probabilitiesOfInputs(float *out, const Eigen::VectorXf &input, float value) const
+void GaussianMixture::probabilitiesOfInputs(float *out, const std::vector<unsigned int> &clusters, const Eigen::VectorXf &input) const
 {
-    // Probability of the input for all the clusters
-    for (std::size_t cluster=0; cluster<numberOfClusters(); ++cluster) {
-        out[cluster] = probabilityOfInput(cluster, input) * _probabilities[cluster];
+    float inv_sum_sp = 1.0f / _sum_sprobabilities;
+
+    // Probability of the input for the clusters
+    mahalanobisDistances(out, clusters, input);
+
+    for (std::size_t i=0; i<clusters.size(); ++i) {
+        unsigned int cluster = clusters[i];
+
+        out[i] = _gaussian_normalizations[cluster] * std::exp(-0.5f * out[i]) * _sprobabilities[cluster] * inv_sum_sp;
     }
 }
 
-void GaussianMixture::probabilitiesOfClusters(float *out, const Eigen::VectorXf &input, float value) const
+void GaussianMixture::probabilitiesOfClusters(float *out, const std::vector<unsigned int> &clusters, const Eigen::VectorXf &input) const
 {
-    float *input_probas = NEW_VEC;
+    float *input_probas = NEW_VEC(clusters.size());
 
-    probabilitiesOfInputs(input_probas, input, value);
-    probabilitiesOfClusters(out, input_probas);
+    probabilitiesOfInputs(input_probas, clusters, input);
+    probabilitiesOfClusters(out, input_probas, clusters.size());
 }
 
-void GaussianMixture::probabilitiesOfClusters(float *out, float *input_probabilities) const
+void GaussianMixture::probabilitiesOfClusters(float *out, float *input_probabilities, unsigned int count) const
 {
     // Compute, for each cluster, p(input|cluster)*p(cluster) / sum(probabilities)
-    float proba_x = std::accumulate(input_probabilities, input_probabilities + numberOfClusters(), 0.0f);
+    float proba_x = std::accumulate(input_probabilities, input_probabilities + count, 0.0f);
     float inv_proba_x = 1 / proba_x;
 
-    for (std::size_t cluster=0; cluster<numberOfClusters(); ++cluster) {
-        out[cluster] = input_probabilities[cluster] * inv_proba_x;
+    for (unsigned int i=0; i<count; ++i) {
+        out[i] = input_probabilities[i] * inv_proba_x;
     }
 }
+
+std::size_t GaussianMixture::CellHash::operator()(const Cell &cell) const
+{
+    std::size_t acc = 0;
+    auto h = std::hash<int>();
+
+    for (int c : cell) {
+        acc ^= h(c) + 0x9e3779b9 + (acc << 6) + (acc >> 2);
+    }
+
+    return acc;
+}
@@ -25,68 +25,241 @@
 
 #include <Eigen/Dense>
 #include <vector>
+#include <unordered_map>
+#include <functional>
 
 /**
  * @brief Function approximator based on an incremental gaussian mixture model
+ *
+ * The mixture can have several outputs. The clusters are shared by all the
+ * outputs, each cluster having one weight per output, so that the values of
+ * all the outputs are given by a single density evaluation.
+ *
+ * The means of the clusters are indexed by a hash grid, so that only the clusters
+ * close enough to a point are considered when computing its value or when
+ * learning. The clusters farther than -2 log(prune_threshold) (squared
+ * Mahalanobis distance) are pruned, unless their total contribution to the
+ * density of the point, bounded using the largest p(i) / sqrt(|covariance(i)|)
+ * of the mixture, may exceed prune_threshold times the density given by the
+ * kept clusters. In this case, the cutoff distance is increased until the
+ * bound holds. A value is therefore off by at most
+ * prune_threshold * (largest weight - smallest weight) compared to an
+ * evaluation of all the clusters.
+ *
+ * When many clusters have to be evaluated for a point, the Mahalanobis
+ * distances can be computed by several threads, see setParallelFor().
  */
 class GaussianMixture
 {
     public:
+        /**
+         * @brief Function that calls task(i) for every i in [0, count), possibly
+         *        in parallel, and returns when all the calls have finished.
+         */
+        typedef std::function<void(unsigned int count, const std::function<void(unsigned int)> &task)> ParallelFor;
+
         /**
          * @param var_initial Initial variance of a gaussian cluster
          * @param novelty Minimum probability that a point is in a cluster in
          *                order for it to be added to the cluster.
+         * @param prune_threshold Maximum fraction of the density of a point that
+         *                        may be ignored by pruning far clusters, see
+         *                        above. 0 disables the pruning and considers
+         *                        all the clusters.
          */
-        GaussianMixture(float var_initial, float novelty);
+        GaussianMixture(float var_initial, float novelty, float prune_threshold = 1e-4f);
 
         /**
-         * @brief Set the value of a point
+         * @brief Set the value of a point, for mixtures having one output
          */
         void setValue(const Eigen::VectorXf &input, float value);
 
         /**
-         * @brief Get the value of a point
+         * @brief Set the values of all the outputs at a point
+         *
+         * @p values must always have the same size, that is the number of
+         *        outputs of this mixture.
+         */
+        void setValues(const Eigen::VectorXf &input, const Eigen::VectorXf &values);
+
+        /**
+         * @brief Get the value of a point, for mixtures having one output
          */
         float value(const Eigen::VectorXf &input) const;
 
+        /**
+         * @brief Get the values of all the outputs at a point
+         *
+         * @note If the mixture is empty, @p rs keeps its size and is filled
+         *       with zeroes.
+         */
+        void values(const Eigen::VectorXf &input, Eigen::VectorXf &rs) const;
+
         /**
          * @brief Number of clusters in the model (for statistics)
          */
         unsigned int numberOfClusters() const;
 
+        /**
+         * @brief Merge overlapping clusters and drop the least probable ones
+         *
+         * Two clusters are merged (by moment matching) when the mean of one
+         * of them passes the novelty criterion of the other.
+         *
+         * @param max_clusters Maximum number of clusters kept after this call.
+         *                     The clusters having the smallest sp(i) are removed.
+         * @param max_checks Number of clusters examined for merging. Successive
+         *                   calls continue where the previous one stopped, so
+         *                   that the whole model is eventually examined.
+         */
+        void consolidate(unsigned int max_clusters, unsigned int max_checks);
+
+        /**
+         * @brief Use @p parallel_for to compute the Mahalanobis distances of a
+         *        point to the clusters, when there are enough of them to
+         *        amortize the synchronization of the threads.
+         */
+        void setParallelFor(const ParallelFor &parallel_for);
+
     private:
+        typedef std::vector<int> Cell;
+
+        struct CellHash
+        {
+            std::size_t operator()(const Cell &cell) const;
+        };
+
+        typedef std::unordered_map<Cell, std::vector<unsigned int>, CellHash> Grid;
+
         /**
          * @brief Compute p(input|cluster)
          */
         float probabilityOfInput(unsigned int cluster, const Eigen::VectorXf &input) const;
 
         /**
-         * @brief Probabilities of all the inputs
+         * @brief Squared Mahalanobis distance between @p input and the mean of
+         *        a cluster, computed using the Cholesky factor of its covariance.
+         */
+        float mahalanobisDistance(unsigned int cluster, const Eigen::VectorXf &input) const;
+
+        /**
+         * @brief Squared Mahalanobis distances between @p input and some clusters,
+         *        computed with _parallel_for if there are enough clusters.
+         */
+        void mahalanobisDistances(float *out, const std::vector<unsigned int> &clusters, const Eigen::VectorXf &input) const;
+
+        /**
+         * @brief Normalization factor 1/sqrt(|covariance|) of a cluster, computed
+         *        from the diagonal of its Cholesky factor.
+         */
+        float gaussianNormalization(unsigned int cluster) const;
+
+        /**
+         * @brief Upper bound on the largest eigenvalue of the covariance of a
+         *        cluster, |L|_1 * |L|_inf.
+         */
+        float varianceBound(unsigned int cluster) const;
+
+        /**
+         * @brief Cell of the grid in which a point falls
+         */
+        Cell cellOf(const Eigen::VectorXf &point) const;
+
+        /**
+         * @brief Put a cluster in the grid cell of its mean, removing it from
+         *        its previous cell if it has moved.
+         */
+        void placeCluster(unsigned int cluster);
+
+        /**
+         * @brief Update the variance bound of a cluster whose covariance has changed
+         */
+        void updateVarianceBound(unsigned int cluster);
+
+        /**
+         * @brief Remove a cluster from the grid cell in which it is stored
+         */
+        void unplaceCluster(unsigned int cluster);
+
+        /**
+         * @brief Remove a cluster from the model. The last cluster takes its index.
+         */
+        void removeCluster(unsigned int cluster);
+
+        /**
+         * @brief Merge cluster @p other into @p cluster, and remove @p other
+         *
+         * @return New index of @p cluster, that changes if it was the last one
+         */
+        unsigned int mergeClusters(unsigned int cluster, unsigned int other);
+
+        /**
+         * @brief List the clusters that may have a non-negligible probability
+         *        for @p input.
+         *
+         * The Mahalanobis distance of a cluster is at least |x - mu|² / lambda_max,
+         * so only the cells closer than sqrt(cutoff * max(lambda_max)) to
+         * @p input need to be looked at.
+         *
+         * @param cutoff Squared Mahalanobis distance beyond which clusters are
+         *               pruned, infinity to list all the clusters
+         */
+        void candidateClusters(const Eigen::VectorXf &input, float cutoff, std::vector<unsigned int> &clusters) const;
+
+        /**
+         * @brief Squared Mahalanobis distance beyond which the clusters can be
+         *        pruned, given the density of a point already found
+         *
+         * @param kept_mass Sum of p(input|cluster)*p(cluster) over the candidates
+         *                  found with _cutoff_mahalanobis
+         * @return At least _cutoff_mahalanobis, infinity if all the clusters
+         *         have to be considered.
+         */
+        float pruningCutoff(float kept_mass) const;
+
+        /**
+         * @brief Update _max_density_factor after the normalization or sp(i)
+         *        of a cluster has grown
+         */
+        void updateDensityFactor(unsigned int cluster);
+
+        /**
+         * @brief Probabilities of the inputs, p(input|cluster)*p(cluster), for
+         *        some clusters
          */
-        void probabilitiesOfInputs(float *out, const Eigen::VectorXf &input, float value) const;
+        void probabilitiesOfInputs(float *out, const std::vector<unsigned int> &clusters, const Eigen::VectorXf &input) const;
 
         /**
-         * @brief Compute p(cluster|input) for all the clusters
+         * @brief Compute p(cluster|input) for some clusters
          *
          * Computing the probabilities of all the clusters takes only marginally
          * more time than computing the probability of only one cluster, hence
          * this function that returns all the probabilities.
          */
-        void probabilitiesOfClusters(float *out, const Eigen::VectorXf &input, float value) const;
-        void probabilitiesOfClusters(float *out, float *input_probabilities) const;
+        void probabilitiesOfClusters(float *out, const std::vector<unsigned int> &clusters, const Eigen::VectorXf &input) const;
+        void probabilitiesOfClusters(float *out, float *input_probabilities, unsigned int count) const;
 
     private:
         float _var_initial;
         float _novelty;
 
-        float _inv_2pi_d;                                                       /*!< @brief 1/(2pi ^ (D/2)), used to normalize the gaussians */
-        std::vector<float> _gaussian_normalizations;                            /*!< @brief Each cluster has a normalization factor equal to _inv_2pi_d / sqrt(|covariance(i)|) */
-        std::vector<float> _probabilities;                                      /*!< @brief Probabilities of all the clusters */
+        float _max_mahalanobis;                                                 /*!< @brief -2 log(novelty), squared distance under which a point belongs to a cluster */
+        float _prune_threshold;
+        float _cutoff_mahalanobis;                                              /*!< @brief Squared distance above which clusters are pruned, at least _max_mahalanobis */
+        float _max_density_factor;                                              /*!< @brief Upper bound on normalization(i) * sp(i) over all the clusters, recomputed by consolidate() */
+        float _cell_size;                                                       /*!< @brief Size of the cells of the grid, in every dimension */
+        float _max_variance_bound;                                              /*!< @brief Largest element of _variance_bounds */
+        float _sum_sprobabilities;                                              /*!< @brief sum(sp(*)), kept up to date so that p(i) can be computed in O(1) */
+        unsigned int _consolidate_cursor;                                       /*!< @brief Next cluster to be examined by consolidate() */
+        std::vector<float> _gaussian_normalizations;                            /*!< @brief Each cluster has a normalization factor equal to 1 / sqrt(|covariance(i)|). 1/(2pi ^ (D/2)) is common to all the clusters and cancels out in p(cluster|input), so it is omitted (it underflows for large D) */
         std::vector<float> _sprobabilities;                                     /*!< @brief sp(i) values of the clusters, used to compute p(i) = sp(i) / sum(sp(*)) */
-        std::vector<float> _weights;                                            /*!< @brief Weights of all the clusters */
-        std::vector<Eigen::MatrixXf> _covariances;                              /*!< @brief Covariance matrices for all the clusters */
-        std::vector<Eigen::MatrixXf> _inv_covariances;                          /*!< @brief Inverse of covariance matrices for all the clusters, used to speed up value() */
+        std::vector<Eigen::VectorXf> _weights;                                  /*!< @brief Weights of all the clusters, one per output */
+        std::vector<float> _variance_bounds;                                    /*!< @brief Upper bound on the largest eigenvalue of the covariance of each cluster */
+        std::vector<Eigen::MatrixXf> _cholesky;                                 /*!< @brief Lower-triangular Cholesky factors L of the covariance matrices (covariance = LL') */
         std::vector<Eigen::VectorXf> _means;                                    /*!< @brief Centroids of all the gaussians */
+        std::vector<Cell> _cells;                                               /*!< @brief Grid cell in which the mean of each cluster is stored */
+        Grid _grid;                                                             /*!< @brief Clusters indexed by the cell of their mean */
+        ParallelFor _parallel_for;                                              /*!< @brief Parallel loop used by mahalanobisDistances(), empty to compute the distances sequentially */
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -22,8 +22,18 @@
 
 #include "psr.h"
 
+#include <algorithm>
+
 #include <assert.h>
 
+/**
+ * @brief View a matrix as a column vector, column after column
+ */
+static Eigen::Map<Eigen::VectorXf> asVector(Eigen::MatrixXf &m)
+{
+    return Eigen::Map<Eigen::VectorXf>(m.data(), m.size());
+}
+
 PSR::PSR(unsigned int history_length,
          unsigned int ao_length,
          unsigned int test_length,
@@ -62,24 +72,32 @@ PSR::PSR(unsigned int history_length,
     _binf = Eigen::MatrixXf::Zero(1, _rank);
     _bao = Eigen::MatrixXf::Zero(_rank, _rank);
 
-    // The candidate Bao is a _rank * _ao_length * _rank cube (height * width * depth).
-    // At first, this cube is uninitialized
-    _candidate_bao.reserve(_rank);
-
-    for (unsigned int i=0; i<_rank; ++i) {
-        _candidate_bao.push_back(Eigen::MatrixXf::Zero(_rank, _ao_length));
-    }
+    // The candidate Bao is a _rank * _rank * _ao_length cube (height * width * depth),
+    // stored as _ao_length _rank * _rank blocks. It is initially null
+    _candidate_bao = Eigen::MatrixXf::Zero(_rank, _ao_length * _rank);
 
     // Allocate memory for the other matrices (without initialization)
+    _sigma_ao_left.resize(_ao_length);
+    _sigma_ao_right.resize(_ao_length);
+    _ut_future.resize(_rank);
+    _vt_history.resize(_rank);
+    _ct.resize(_test_length);
+    _c.resize(_test_length);
+    _dt.resize(_history_length);
+    _d.resize(_history_length);
+    _next_u.resize(_test_length, _rank);
+    _next_v.resize(_history_length, _rank);
     _uct.resize(_rank + 1, 1);
     _hvd.resize(1, _rank + 1);
     _k.resize(_rank + 1, _rank + 1);
 
+    _bao_first_dim.resize(_rank);
     _bao_third_dim.resize(_rank);
-    _bao_onesecond_dim.resize(_rank, _ao_length);
+    _bao_update.resize(_rank, _rank);
+    _projected_ao.resize(_ao_length);
 
-    // _k, _c and _d don't need to be initialized. They are member fields only
-    // so that memory can be reused between updates
+    // _k, _c, _d and the other workspaces don't need to be initialized. They
+    // are member fields only so that memory can be reused between updates
 }
 
 void PSR::train(const Eigen::VectorXf &history,
@@ -90,29 +108,37 @@ void PSR::train(const Eigen::VectorXf &history,
     _mu_h += history;
 
     // Update _inv_sigma_ao using the Sherman-Morrison formula
-    _inv_sigma_ao.array() -=
-        ((_inv_sigma_ao * ao) * (ao.transpose() * _inv_sigma_ao)).array() /
-        ((ao.transpose() * _inv_sigma_ao * ao).value() + 1.0f);
-
-    // Compute the C and D matrices
-    _ct = (
-        Eigen::MatrixXf::Identity(_test_length, _test_length) -
-        _u * _u.transpose()
-    ) * future;
-    _dt = (
-        Eigen::MatrixXf::Identity(_history_length, _history_length) -
-        _v * _v.transpose()
-    ) * history;
-    _c = _ct / _ct.norm();
-    _d = _dt / _dt.norm();
+    _sigma_ao_left.noalias() = _inv_sigma_ao * ao;
+    _sigma_ao_right.noalias() = _inv_sigma_ao.transpose() * ao;
+    _inv_sigma_ao.noalias() -=
+        (_sigma_ao_left / (ao.dot(_sigma_ao_left) + 1.0f)) * _sigma_ao_right.transpose();
+
+    // Compute the C and D matrices, the components of the future and history
+    // orthogonal to U and V. (I - UU')f is computed as f - U(U'f), so that no
+    // n*n matrix is built.
+    _ut_future.noalias() = _u.transpose() * future;
+    _vt_history.noalias() = _v.transpose() * history;
+
+    _ct = future;
+    _ct.noalias() -= _u * _ut_future;
+    _dt = history;
+    _dt.noalias() -= _v * _vt_history;
+
+    float ct_norm = _ct.norm();
+    float dt_norm = _dt.norm();
+
+    _c = _ct / ct_norm;
+    _d = _dt / dt_norm;
 
     // Updating K requires the construction of two temporary vectors with one
-    // more element that C and D
-    _uct.block(0, 0, _rank, 1) = _u.transpose() * future;
-    _uct.block(_rank, 0, 1, 1) = _c.transpose() * future;
+    // more element that C and D. C'f is the norm of the orthogonal component
+    // of f. Computing it as a dot product with f would add the rounding
+    // errors of U'f, that dominate when f is almost in the span of U.
+    _uct.block(0, 0, _rank, 1) = _ut_future;
+    _uct(_rank, 0) = ct_norm;
 
-    _hvd.block(0, 0, 1, _rank) = history.transpose() * _v;
-    _hvd.block(0, _rank, 1, 1) = history.transpose() * _d;
+    _hvd.block(0, 0, 1, _rank) = _vt_history.transpose();
+    _hvd(0, _rank) = dt_norm;
 
     // K can now be updated easily
     _k.setZero();
@@ -127,8 +153,13 @@ void PSR::train(const Eigen::VectorXf &history,
     const auto &matrixU = _k_jacobi.matrixU();
     const auto &matrixV = _k_jacobi.matrixV();
 
-    _u = _u * matrixU.block(0, 0, _rank, _rank) + _c * matrixU.block(_rank, 0, 1, _rank);
-    _v = _v * matrixV.block(0, 0, _rank, _rank) + _d * matrixV.block(_rank, 0, 1, _rank);
+    _next_u.noalias() = _u * matrixU.block(0, 0, _rank, _rank);
+    _next_u.noalias() += _c * matrixU.block(_rank, 0, 1, _rank);
+    _next_v.noalias() = _v * matrixV.block(0, 0, _rank, _rank);
+    _next_v.noalias() += _d * matrixV.block(_rank, 0, 1, _rank);
+
+    _u.swap(_next_u);
+    _v.swap(_next_v);
     _s.diagonal() = _k_jacobi.singularValues().block(0, 0, _rank, 1);
 
     if (_s.diagonal().minCoeff() < 1e-10) {
@@ -149,13 +180,12 @@ void PSR::train(const Eigen::VectorXf &history,
     // identity matrices. Furthermore, U and V have not grown since last call to
     // learn(), so the computation of Bupdate is not needed (no added zero, only
     // identities). Add "Bnew" to Bao.
-    _bao_third_dim = _inv_s * (_v.transpose() * history);
-    _bao_onesecond_dim = _u.transpose() * future * ao.transpose();
+    _bao_first_dim.noalias() = _u.transpose() * future;
+    _bao_third_dim.noalias() = _inv_s * (_v.transpose() * history);
+    _bao_update.noalias() = _bao_first_dim * _bao_third_dim.transpose();
 
-    for (unsigned int i=0; i<_rank; ++i) {
-        // NOTE: A lambda has been removed ("weight vector", Bao(i, i, i) = lambda_i)
-        _candidate_bao[i] += _bao_onesecond_dim * _bao_third_dim(i);
-    }
+    // NOTE: A lambda has been removed ("weight vector", Bao(i, i, i) = lambda_i)
+    candidateBao().noalias() += asVector(_bao_update) * ao.transpose();
 
     // Compute the updated PSR parameters
     _b1 = (_s * _v.transpose()).col(0);                 // NOTE: Taking the first column is equivalent to the multiplication by "e" in the article, with the definition of e given in "Closing the loop with PSR"
@@ -164,19 +194,147 @@ void PSR::train(const Eigen::VectorXf &history,
     // _bao is updated at each action-observation
 }
 
+void PSR::train(const Eigen::MatrixXf &histories,
+                const Eigen::MatrixXf &aos,
+                const Eigen::MatrixXf &futures)
+{
+    unsigned int block_size = histories.cols();
+
+    if (block_size == 0) {
+        return;
+    }
+
+    // Update the average history
+    _mu_h += histories.rowwise().sum();
+
+    // Update _inv_sigma_ao with the Woodbury formula, the block version of
+    // Sherman-Morrison: (A + XX')^-1 = A^-1 - A^-1 X (I + X'A^-1 X)^-1 X'A^-1
+    Eigen::MatrixXf left = _inv_sigma_ao * aos;
+    Eigen::MatrixXf right = aos.transpose() * _inv_sigma_ao;
+    Eigen::MatrixXf capacitance = aos.transpose() * left;
+
+    capacitance.diagonal().array() += 1.0f;
+    _inv_sigma_ao.noalias() -= left * capacitance.partialPivLu().solve(right);
+
+    // Components of the futures and histories orthogonal to U and V, and an
+    // orthonormal basis of them given by a QR decomposition (C and D of the
+    // sample-per-sample update, with one column per sample)
+    Eigen::MatrixXf ut_futures = _u.transpose() * futures;
+    Eigen::MatrixXf vt_histories = _v.transpose() * histories;
+    Eigen::MatrixXf ct = futures;
+    Eigen::MatrixXf dt = histories;
+
+    ct.noalias() -= _u * ut_futures;
+    dt.noalias() -= _v * vt_histories;
+
+    Eigen::HouseholderQR<Eigen::MatrixXf> cQR(ct);
+    Eigen::HouseholderQR<Eigen::MatrixXf> dQR(dt);
+    unsigned int c_size = std::min(_test_length, block_size);
+    unsigned int d_size = std::min(_history_length, block_size);
+    Eigen::MatrixXf c = cQR.householderQ() * Eigen::MatrixXf::Identity(_test_length, c_size);
+    Eigen::MatrixXf d = dQR.householderQ() * Eigen::MatrixXf::Identity(_history_length, d_size);
+
+    // K = [S 0; 0 0] + [U'F; Rc] [V'H; Rd]', the projection of U S V' + F H'
+    // on the bases [U C] and [V D]
+    Eigen::MatrixXf uct(_rank + c_size, block_size);
+    Eigen::MatrixXf hvd(_rank + d_size, block_size);
+    Eigen::MatrixXf k = Eigen::MatrixXf::Zero(_rank + c_size, _rank + d_size);
+
+    uct.topRows(_rank) = ut_futures;
+    uct.bottomRows(c_size) = cQR.matrixQR().topRows(c_size).triangularView<Eigen::Upper>();
+    hvd.topRows(_rank) = vt_histories;
+    hvd.bottomRows(d_size) = dQR.matrixQR().topRows(d_size).triangularView<Eigen::Upper>();
+
+    k.block(0, 0, _rank, _rank) = _s;
+    k.noalias() += uct * hvd.transpose();
+
+    // Single SVD decomposition for the whole block, keeping the rank largest
+    // singular values
+    Eigen::JacobiSVD<Eigen::MatrixXf> svd(k, Eigen::ComputeThinU | Eigen::ComputeThinV);
+    const auto &matrixU = svd.matrixU();
+    const auto &matrixV = svd.matrixV();
+
+    _next_u.noalias() = _u * matrixU.block(0, 0, _rank, _rank);
+    _next_u.noalias() += c * matrixU.block(_rank, 0, c_size, _rank);
+    _next_v.noalias() = _v * matrixV.block(0, 0, _rank, _rank);
+    _next_v.noalias() += d * matrixV.block(_rank, 0, d_size, _rank);
+
+    _u.swap(_next_u);
+    _v.swap(_next_v);
+    _s.diagonal() = svd.singularValues().head(_rank);
+
+    if (_s.diagonal().minCoeff() < 1e-10) {
+        // Not yet enough data, skip learning here
+        return;
+    } else {
+        _inv_s.diagonal() = _s.diagonal().cwiseInverse();
+    }
+
+    // Keep U and V orthogonal (this correction is done every once and then)
+    _num_train += block_size;
+
+    if (_num_train >= 200) {
+        _num_train = 0;
+
+        fixUV();
+    }
+
+    // Add the "Bnew" of every sample to Bao. Column j of updates is the
+    // vectorized outer product of U'f_j and S^-1 V'h_j, so that all the
+    // samples are added with one matrix product.
+    Eigen::MatrixXf first_dims = _u.transpose() * futures;
+    Eigen::MatrixXf third_dims = _inv_s * (_v.transpose() * histories);
+    Eigen::MatrixXf updates(_rank * _rank, block_size);
+
+    for (unsigned int j=0; j<block_size; ++j) {
+        _bao_update.noalias() = first_dims.col(j) * third_dims.col(j).transpose();
+        updates.col(j) = asVector(_bao_update);
+    }
+
+    candidateBao().noalias() += updates * aos.transpose();
+
+    // Compute the updated PSR parameters
+    _b1 = (_s * _v.transpose()).col(0);
+    _binf = _mu_h.transpose() * _v * _inv_s;
+}
+
 void PSR::reset()
 {
     // Reset the current belief to the initial belief
     _belief = _b1;
 }
 
+void PSR::copyParameters(const PSR &other)
+{
+    assert(_history_length == other._history_length);
+    assert(_ao_length == other._ao_length);
+    assert(_test_length == other._test_length);
+    assert(_rank == other._rank);
+
+    _mu_h = other._mu_h;
+    _inv_sigma_ao = other._inv_sigma_ao;
+    _u = other._u;
+    _s = other._s;
+    _inv_s = other._inv_s;
+    _v = other._v;
+    _b1 = other._b1;
+    _binf = other._binf;
+    _candidate_bao = other._candidate_bao;
+    _num_train = other._num_train;
+}
+
 float PSR::update(const Eigen::VectorXf &ao)
 {
     computeBao(ao);
 
     // Update the current belief
     _pre_belief = _bao * _belief;
-    _belief = _pre_belief / (_binf * _pre_belief).value();
+
+    float proba = (_binf * _pre_belief).value();
+
+    _belief = _pre_belief / proba;
+
+    return proba;
 }
 
 float PSR::predict(const Eigen::VectorXf &ao)
@@ -187,6 +345,16 @@ float PSR::predict(const Eigen::VectorXf &ao)
     return (_binf * _bao * _belief).value();
 }
 
+void PSR::predictionWeights(Eigen::VectorXf &weights)
+{
+    // binf * Bao * belief, with vec(Bao) = candidate_bao * inv_sigma_ao' * ao,
+    // is g' * inv_sigma_ao' * ao with g = candidate_bao' * vec(binf' * belief')
+    Eigen::MatrixXf outer = _binf.transpose() * _belief.transpose();
+    Eigen::VectorXf g = candidateBao().transpose() * asVector(outer);
+
+    weights.noalias() = _inv_sigma_ao * g;
+}
+
 void PSR::fixUV()
 {
     Eigen::HouseholderQR<Eigen::MatrixXf> uQR(_u);
@@ -205,10 +373,14 @@ void PSR::fixUV()
 
 void PSR::computeBao(const Eigen::VectorXf &ao)
 {
-    // Compute the _bao corresponding to this action-observation
-    for (unsigned int i=0; i<_rank; ++i) {
-        // This computes rank * rank Bao column by column, each rank*AO * AO*1
-        // will give a rank*1 column.
-        _bao.col(i) = _candidate_bao[i] * (_inv_sigma_ao.transpose() * ao);
-    }
+    // Compute the _bao corresponding to this action-observation. Every element
+    // of Bao is a dot product between the projected action-observation and a
+    // row of the (rank*rank)*ao view of the candidate Bao.
+    _projected_ao.noalias() = _inv_sigma_ao.transpose() * ao;
+    asVector(_bao).noalias() = candidateBao() * _projected_ao;
+}
+
+Eigen::Map<Eigen::MatrixXf> PSR::candidateBao()
+{
+    return Eigen::Map<Eigen::MatrixXf>(_candidate_bao.data(), _rank * _rank, _ao_length);
 }
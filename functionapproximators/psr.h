@@ -81,11 +81,41 @@ class PSR
                    const Eigen::VectorXf &ao,
                    const Eigen::VectorXf &future);
 
+        /**
+         * @brief Train the model with a block of samples at once
+         *
+         * This is equivalent to calling train() for every sample, but the
+         * spectral decomposition is updated with a single rank-k update and
+         * one SVD for the whole block, and Sigma_AO,AO with one Woodbury
+         * update. The result differs slightly from the sample-per-sample
+         * update, because the decomposition is truncated to rank singular
+         * values once per block instead of once per sample.
+         *
+         * @param histories One history per column
+         * @param aos       One action-observation per column
+         * @param futures   One future per column
+         *
+         * @note The cost of the SVD grows with the cube of rank plus the number
+         *       of samples, so blocks should contain a few tens of samples.
+         */
+        void train(const Eigen::MatrixXf &histories,
+                   const Eigen::MatrixXf &aos,
+                   const Eigen::MatrixXf &futures);
+
         /**
          * @brief Reset the model to its initial state
          */
         void reset();
 
+        /**
+         * @brief Copy the learned parameters of another PSR of the same size
+         *
+         * Only the parameters that other reads when predicting are copied,
+         * its belief and work vectors are left untouched. This allows to copy
+         * a PSR while another thread updates its belief.
+         */
+        void copyParameters(const PSR &other);
+
         /**
          * @brief Advance the model one step by providing an action-observation
          *        pair.
@@ -100,6 +130,16 @@ class PSR
          */
         float predict(const Eigen::VectorXf &ao);
 
+        /**
+         * @brief Compute weights w such that predict(ao) = w.dot(ao) for the
+         *        current belief.
+         *
+         * The prediction is linear in the action-observation, so computing
+         * these weights once allows to evaluate many candidate action-observations
+         * with a dot product each, instead of contracting Bao for every one.
+         */
+        void predictionWeights(Eigen::VectorXf &weights);
+
     private:
         /**
          * @brief Fix U and V so that they remain orthogonal
@@ -112,13 +152,23 @@ class PSR
          */
         void computeBao(const Eigen::VectorXf &ao);
 
+        /**
+         * @brief View of the candidate Bao as a (rank*rank)*ao matrix, row
+         *        i + rank*j containing the coefficients of Bao(i, j).
+         */
+        Eigen::Map<Eigen::MatrixXf> candidateBao();
+
     private:
         // Many of the following matrices are temporary values kept in the class
         // so that memory can be reused between calls to train() and update().
         Eigen::VectorXf _mu_h;                  /*!< @brief Average features over all the histories */
         Eigen::MatrixXf _inv_sigma_ao;          /*!< @brief Inverse of the Sigma_AO,AO covariance matrix */
         Eigen::MatrixXf _u, _s, _inv_s, _v;     /*!< @brief U, S and V matrices of the SVD decomposition of _inv_sigma_ao */
-        Eigen::MatrixXf _ct, _c, _dt, _d;       /*!< @brief C and D vectors used for computing K */
+        Eigen::VectorXf _sigma_ao_left;         /*!< @brief _inv_sigma_ao * ao, used by the Sherman-Morrison update */
+        Eigen::VectorXf _sigma_ao_right;        /*!< @brief _inv_sigma_ao' * ao, used by the Sherman-Morrison update */
+        Eigen::VectorXf _ut_future, _vt_history;    /*!< @brief Projections of the future and history on U and V */
+        Eigen::VectorXf _ct, _c, _dt, _d;       /*!< @brief C and D vectors used for computing K */
+        Eigen::MatrixXf _next_u, _next_v;       /*!< @brief Updated U and V, swapped with _u and _v */
         Eigen::MatrixXf _uct, _hvd;             /*!< @brief Vectors with one more element than C and D used for computing K */
         Eigen::MatrixXf _k;                     /*!< @brief K matrix used for updating U, S and V */
         Eigen::MatrixXf _b1;                    /*!< @brief Belief after a reset (approximately the expected belief over all the histories) */
@@ -129,10 +179,14 @@ class PSR
         // SVD solver used for computing K so that its internal matrices are cached
         Eigen::JacobiSVD<Eigen::MatrixXf> _k_jacobi;
 
-        // size1*size2 slices, there are size3 slices
-        std::vector<Eigen::MatrixXf> _candidate_bao;    /*!< @brief Bao computed from S, U, V and others */
-        Eigen::MatrixXf _bao_onesecond_dim;             /*!< @brief Matrix of coefficients used to compute the first and second dimensions of Bao */
+        // The candidate Bao is a rank*rank*ao tensor, stored as ao rank*rank
+        // blocks side by side. Seen as a (rank*rank)*ao matrix, its product with
+        // a projected action-observation gives Bao in one matrix-vector product.
+        Eigen::MatrixXf _candidate_bao;                 /*!< @brief Bao computed from S, U, V and others, _rank * (_ao_length * _rank) */
+        Eigen::VectorXf _bao_first_dim;                 /*!< @brief Vector of coefficients used to compute the first dimension of Bao */
         Eigen::VectorXf _bao_third_dim;                 /*!< @brief Vector of coefficients used to compute the third dimension of Bao */
+        Eigen::MatrixXf _bao_update;                    /*!< @brief Outer product of _bao_first_dim and _bao_third_dim */
+        Eigen::VectorXf _projected_ao;                  /*!< @brief Action-observation multiplied by the transpose of _inv_sigma_ao */
         Eigen::MatrixXf _bao;                           /*!< @brief Final Bao, computed from _candidate_bao and adjustment factors. This is a matrix, not a 3D tensor. */
 
         unsigned int _history_length;
@@ -24,6 +24,7 @@
 #define __ABSTRACTLEARNING_H__
 
 #include <model/episode.h>
+#include <model/random.h>
 
 /**
  * @brief Learning algorithm
@@ -44,6 +45,46 @@ class AbstractLearning
          */
         virtual void actions(Episode *episode, std::vector<float> &probabilities, float &td_error) = 0;
 
+        /**
+         * @brief Choose the action to take, given the @p probabilities returned
+         *        by the last call to actions().
+         *
+         * The default implementation samples an action from @p probabilities.
+         * Learning algorithms that already drew the action in actions() return
+         * it instead, so that a single random number is drawn per time step.
+         */
+        virtual unsigned int chooseAction(const std::vector<float> &probabilities)
+        {
+            return Random::local().sample(probabilities);
+        }
+
+        /**
+         * @brief Finish updating the values of @p episode, just before a model
+         *        learns them.
+         *
+         * Learning algorithms that defer their updates to the end of the
+         * episodes apply them here. The default implementation does nothing.
+         */
+        virtual void finishEpisode(Episode *episode)
+        {
+            (void) episode;
+        }
+
+        /**
+         * @brief Whether actions() can be skipped at some time steps without
+         *        losing any update of the values.
+         *
+         * This is the case when the updates of the skipped time steps are
+         * applied by the next call to actions(), or by finishEpisode(). Such
+         * algorithms must not modify the values of the last time step, so
+         * that the best action can be read from the episode when actions()
+         * is skipped.
+         */
+        virtual bool lazyUpdates() const
+        {
+            return false;
+        }
+
         /**
          * @brief Return the number of value elements to be stored in an episode
          *        given the number of possible actions.
@@ -22,39 +22,40 @@
 
 #include "abstracttdlearning.h"
 
-AbstractTDLearning::AbstractTDLearning(float discount_factor, float eligibility_factor, float learning_rate)
+#include <algorithm>
+#include <cmath>
+
+AbstractTDLearning::AbstractTDLearning(float discount_factor, float eligibility_factor, float learning_rate, Traces traces)
 : _discount_factor(discount_factor),
   _eligibility_factor(eligibility_factor),
-  _learning_rate(learning_rate)
+  _learning_rate(learning_rate),
+  _traces(traces)
 {
+    // The online traces of a time step are dropped after the number of steps
+    // over which (lambda * gamma)^k falls below 1e-2. With lambda = 1, the
+    // eligibility never decays and this bounds the cost of a time step.
+    float decay = _eligibility_factor * _discount_factor;
+
+    if (decay < 1.0f) {
+        _max_trace_length = std::max(1.0f, std::ceil(std::log(1e-2f) / std::log(decay)));
+    } else {
+        _max_trace_length = ~0u;
+    }
 }
 
 
 void AbstractTDLearning::actions(Episode *episode, std::vector<float> &probabilities, float &td_error)
 {
     // Update the action values using the TD errors
-    float eligibility = 1.0f;
-
     if (episode->length() >= 2) {
-        for (unsigned int current_t = episode->length() - 1; current_t > 0; --current_t) {
-            unsigned int last_action = episode->action(current_t - 1);
-
-            // Compute the TD-error at this time-step
-            float error = tdError(episode, current_t);
-
-            // Update the action value using this error and an eligibility trace
-            episode->addValue(current_t - 1, last_action, _learning_rate * eligibility * error);
-
-            // Update the eligbility trace and set td_error to the TD-error of the
-            // last action (td_error is used to tune exploration/exploitation in
-            // AdaptiveSoftmax).
-            eligibility *= _eligibility_factor;
-
-            if (current_t == episode->length() - 1) {
-                td_error = error;
-            } else if (eligibility < 1e-2) {
-                break;
-            }
+        if (_traces == OnlineTraces) {
+            onlineTraces(episode, td_error);
+        } else if (_traces == DeferredTraces) {
+            // Only the TD error of the last time step is needed now, the
+            // values are updated by finishEpisode()
+            td_error = tdError(episode, episode->length() - 1);
+        } else {
+            replayTraces(episode, td_error);
         }
     } else {
         td_error = 0.0f;
@@ -65,3 +66,103 @@ void AbstractTDLearning::actions(Episode *episode, std::vector<float> &probabili
     episode->values(episode->length() - 1, probabilities);
     probabilities.resize(episode->numActions());
 }
+
+bool AbstractTDLearning::lazyUpdates() const
+{
+    return _traces != ReplayTraces;
+}
+
+void AbstractTDLearning::replayTraces(Episode *episode, float &td_error)
+{
+    float eligibility = 1.0f;
+
+    for (unsigned int current_t = episode->length() - 1; current_t > 0; --current_t) {
+        unsigned int last_action = episode->action(current_t - 1);
+
+        // Compute the TD-error at this time-step
+        float error = tdError(episode, current_t);
+
+        // Update the action value using this error and an eligibility trace
+        episode->addValue(current_t - 1, last_action, _learning_rate * eligibility * error);
+
+        // Update the eligbility trace and set td_error to the TD-error of the
+        // last action (td_error is used to tune exploration/exploitation in
+        // AdaptiveSoftmax).
+        eligibility *= _eligibility_factor;
+
+        if (current_t == episode->length() - 1) {
+            td_error = error;
+        } else if (eligibility < 1e-2) {
+            break;
+        }
+    }
+}
+
+void AbstractTDLearning::onlineTraces(Episode *episode, float &td_error)
+{
+    Episode::Traces &traces = episode->traces();
+
+    td_error = 0.0f;
+
+    // Apply the TD error of every time step not yet seen (usually only the
+    // last one) to the values that are still eligible
+    for (unsigned int t = traces.next_timestep; t < episode->length(); ++t) {
+        Episode::Trace new_trace;
+
+        new_trace.t = t - 1;
+        new_trace.action = episode->action(t - 1);
+        new_trace.eligibility = 1.0f;
+
+        traces.active.push_back(new_trace);
+
+        td_error = tdError(episode, t);
+
+        for (Episode::Trace &trace : traces.active) {
+            episode->addValue(trace.t, trace.action, _learning_rate * trace.eligibility * td_error);
+            trace.eligibility *= _eligibility_factor;
+        }
+
+        // All the traces decay at the same rate, so the oldest ones expire first
+        while (!traces.active.empty() &&
+               (traces.active.front().eligibility < 1e-2 || t - traces.active.front().t >= _max_trace_length)) {
+            traces.active.pop_front();
+        }
+    }
+
+    traces.next_timestep = episode->length();
+}
+
+void AbstractTDLearning::finishEpisode(Episode *episode)
+{
+    if (_traces == OnlineTraces && episode->length() >= 2) {
+        // Apply the TD errors of the time steps skipped by a lazy caller,
+        // including the last one that contains the final reward
+        float td_error;
+
+        onlineTraces(episode, td_error);
+    }
+
+    if (_traces != DeferredTraces || episode->length() < 2) {
+        return;
+    }
+
+    // Compute all the TD errors before updating any value, so that they are
+    // all based on the values predicted while acting
+    unsigned int num_steps = episode->length() - 1;
+
+    _errors.resize(num_steps);
+
+    for (unsigned int t=0; t<num_steps; ++t) {
+        _errors[t] = tdError(episode, t + 1);
+    }
+
+    // Backward pass: the value of time step t receives its TD error plus the
+    // decayed errors of the following time steps
+    float error = 0.0f;
+
+    for (unsigned int t=num_steps; t-- > 0;) {
+        error = _errors[t] + _eligibility_factor * error;
+
+        episode->addValue(t, episode->action(t), _learning_rate * error);
+    }
+}
@@ -31,15 +31,59 @@
 class AbstractTDLearning : public AbstractLearning
 {
     public:
+        /**
+         * @brief Way the TD errors are propagated to the previous time steps
+         */
+        enum Traces {
+            ReplayTraces,       /*!< @brief At every time step, recompute and apply the TD errors of all the recent time steps */
+            OnlineTraces,       /*!< @brief Compute the TD error of a time step once, and apply it to the eligibility traces kept in the episode */
+            DeferredTraces      /*!< @brief Leave the values untouched while acting, and update them in one backward pass over the episode when it is finished, using the values predicted while acting */
+        };
+
         /**
          * @param discount_factor Discount factor used when computing cumulative rewards
          * @param eligbility_factor Discount factor used when computing eligibility traces
          * @param learning_rate Rate at which learning occurs
+         * @param traces Way the TD errors are propagated to the previous time steps.
+         *               OnlineTraces costs O(number of active traces) per time step,
+         *               a trace being active for at most the number of steps
+         *               over which (discount_factor * eligibility_factor)^k
+         *               stays above 1e-2,
+         *               ReplayTraces a scan of the recent time steps, and
+         *               DeferredTraces one TD error per time step.
          */
-        AbstractTDLearning(float discount_factor, float eligibility_factor, float learning_rate);
+        AbstractTDLearning(float discount_factor, float eligibility_factor, float learning_rate, Traces traces = ReplayTraces);
 
         virtual void actions(Episode *episode, std::vector<float> &probabilities, float &td_error);
 
+        /**
+         * @brief Apply the deferred updates to the values of @p episode, if
+         *        the traces are DeferredTraces, or the TD errors of the time
+         *        steps not yet seen by actions() for OnlineTraces.
+         *
+         * With DeferredTraces, the TD errors of all the time steps are
+         * computed from the values predicted while acting, then the value of
+         * every time step receives the errors of the following time steps,
+         * weighted by the eligibility traces. This is the offline equivalent
+         * of OnlineTraces.
+         *
+         * @note The targets of DeferredTraces are stale: they use the values
+         *       that the model predicted when the episode was played, not the
+         *       ones of the model at the end of the episode, and an update does
+         *       not influence the targets of the other time steps as it does
+         *       with OnlineTraces. The learning algorithm has no access to the
+         *       model, so the values are not predicted again. As models are
+         *       only swapped between batches, the values are at most one
+         *       model swap old.
+         */
+        virtual void finishEpisode(Episode *episode);
+
+        /**
+         * @brief Online and deferred traces catch up with the skipped time
+         *        steps, replayed traces do not.
+         */
+        virtual bool lazyUpdates() const;
+
         /**
          * @brief Compute the temporal-difference error between @p timestep - 1
          *        and @p timestep.
@@ -48,10 +92,28 @@ class AbstractTDLearning : public AbstractLearning
          */
         virtual float tdError(const Episode *episode, unsigned int timestep) = 0;
 
+    private:
+        /**
+         * @brief Update the values of the episode by scanning its recent time
+         *        steps backward (ReplayTraces)
+         */
+        void replayTraces(Episode *episode, float &td_error);
+
+        /**
+         * @brief Update the values of the episode using its eligibility
+         *        traces (OnlineTraces)
+         */
+        void onlineTraces(Episode *episode, float &td_error);
+
     protected:
         float _discount_factor;
         float _eligibility_factor;
         float _learning_rate;
+        Traces _traces;
+
+    private:
+        unsigned int _max_trace_length; /*!< @brief Number of time steps after which an online trace is dropped */
+        std::vector<float> _errors;     /*!< @brief TD errors of an episode, used by finishEpisode() */
 };
 
 #endif
@@ -1,17 +1,39 @@
 #include "adaptivesoftmaxlearning.h"
 
 #include <cmath>
+#include <stdint.h>
+
+/**
+ * @brief Number of entries of the table of temperatures of HashedStateEstimator
+ */
+static const unsigned int num_hashed_temperatures = 4096;
+
+/**
+ * @brief Rate at which the running averages of the temperature are updated
+ */
+static const float temperature_rate = 0.1f;
 
 AdaptiveSoftmaxLearning::AdaptiveSoftmaxLearning(AbstractLearning *learning,
-                                                 float discount_factor)
+                                                 float discount_factor,
+                                                 Estimator estimator)
 : SoftmaxLearning(learning, 1.0f),
-  _discount_factor(discount_factor)
+  _discount_factor(discount_factor),
+  _estimator(estimator)
 {
+    if (estimator == GlobalEstimator) {
+        _temperatures.resize(1, 0.0f);
+    } else if (estimator == HashedStateEstimator) {
+        _temperatures.resize(num_hashed_temperatures, 0.0f);
+    }
 }
 
 unsigned int AdaptiveSoftmaxLearning::valueSize(unsigned int num_actions) const
 {
-    return num_actions + 1;
+    if (_estimator == ModelEstimator) {
+        return num_actions + 1;
+    } else {
+        return num_actions;
+    }
 }
 
 float AdaptiveSoftmaxLearning::adjustTemperature(Episode *episode, float td_error)
@@ -26,18 +48,54 @@ float AdaptiveSoftmaxLearning::adjustTemperature(Episode *episode, float td_erro
      * to train the model for the previous observation
      */
     unsigned int current_t = episode->length() - 1;
-    unsigned int temp_index = episode->valueSize() - 1;
+    float current_temperature;
 
-    episode->values(current_t, _values);
+    if (_estimator == ModelEstimator) {
+        unsigned int temp_index = episode->valueSize() - 1;
 
-    float current_temperature = _values[temp_index];
-    float prev_temperature = std::abs(td_error) + _discount_factor * current_temperature;
+        episode->values(current_t, _values);
 
-    // Update the prediction for the last state
-    if (episode->length() > 1) {
-        episode->updateValue(current_t - 1, temp_index, prev_temperature);
+        current_temperature = _values[temp_index];
+        float prev_temperature = std::abs(td_error) + _discount_factor * current_temperature;
+
+        // Update the prediction for the last state
+        if (episode->length() > 1) {
+            episode->updateValue(current_t - 1, temp_index, prev_temperature);
+        }
+    } else {
+        // The table replaces the model: y(t) is read from the entry of the
+        // current state, and the entry of the previous state moves towards
+        // y(t-1).
+        current_temperature = _temperatures[temperatureIndex(episode, current_t)];
+
+        if (episode->length() > 1) {
+            float prev_temperature = std::abs(td_error) + _discount_factor * current_temperature;
+            float &entry = _temperatures[temperatureIndex(episode, current_t - 1)];
+
+            entry += temperature_rate * (prev_temperature - entry);
+        }
     }
 
     // Use the new temperature
     return std::max(0.2f, current_temperature);
 }
+
+unsigned int AdaptiveSoftmaxLearning::temperatureIndex(const Episode *episode, unsigned int t)
+{
+    if (_estimator == GlobalEstimator) {
+        return 0;
+    }
+
+    // FNV-1a hash of the state variables, rounded to two decimals so that
+    // nearly identical continuous states share their entry
+    uint64_t hash = 14695981039346656037ULL;
+
+    episode->state(t, _values);
+
+    for (float v : _values) {
+        hash ^= (uint64_t)std::llround(v * 100.0f);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash % _temperatures.size();
+}
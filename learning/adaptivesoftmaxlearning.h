@@ -29,16 +29,29 @@ class Network;
 /**
  * @brief Softmax that adjusts its temperature depending on the TD-error usually
  *        received at the current state.
+ *
+ * The expected TD-error of a state can either be learned by the model, as an
+ * additional value, or be kept by this class in a small table of running
+ * averages. The table does not make the model larger, but is coarser: it has
+ * a single entry, or one entry per hashed state.
  */
 class AdaptiveSoftmaxLearning : public SoftmaxLearning
 {
     public:
+        enum Estimator {
+            ModelEstimator,             /*!< @brief The temperature is an additional value learned by the model */
+            GlobalEstimator,            /*!< @brief One running average of the temperature for all the states */
+            HashedStateEstimator        /*!< @brief One running average per hashed state, shared by the states having the same hash */
+        };
+
         /**
          * @param learning Learning algorithm that is wrapped by this Softmax
          * @param discount_factor Discount factor applied to future TD errors
+         * @param estimator Where the expected TD errors are stored
          */
         AdaptiveSoftmaxLearning(AbstractLearning *learning,
-                                float discount_factor);
+                                float discount_factor,
+                                Estimator estimator = ModelEstimator);
 
         /**
          * @brief Let a subclass adjust the temperature of Softmax before an action
@@ -47,14 +60,23 @@ class AdaptiveSoftmaxLearning : public SoftmaxLearning
         virtual float adjustTemperature(Episode *episode, float td_error);
 
         /**
-         * @brief Require one more value, so that each state-action has information
-         *        about its expected td-error.
+         * @brief Require one more value when the temperature is learned by the
+         *        model, so that each state-action has information about its
+         *        expected td-error.
          */
         virtual unsigned int valueSize(unsigned int num_actions) const;
 
+    private:
+        /**
+         * @brief Index in _temperatures of the entry of a time step
+         */
+        unsigned int temperatureIndex(const Episode *episode, unsigned int t);
+
     private:
         std::vector<float> _values;
+        std::vector<float> _temperatures;       /*!< @brief Running averages of the temperature, used when the model does not learn it */
         float _discount_factor;
+        Estimator _estimator;
 };
 
 #endif
@@ -25,8 +25,8 @@
 #include <algorithm>
 #include <iostream>
 
-AdvantageLearning::AdvantageLearning(float discount_factor, float eligibility_factor, float learning_rate, float kappa)
-: AbstractTDLearning(discount_factor, eligibility_factor, learning_rate),
+AdvantageLearning::AdvantageLearning(float discount_factor, float eligibility_factor, float learning_rate, float kappa, Traces traces)
+: AbstractTDLearning(discount_factor, eligibility_factor, learning_rate, traces),
   _inv_kappa(1.0f / kappa)
 {
 }
@@ -36,12 +36,9 @@ float AdvantageLearning::tdError(const Episode *episode, unsigned int timestep)
     unsigned int last_action = episode->action(timestep - 1);
     float last_reward = episode->reward(timestep - 1);
 
-    episode->values(timestep - 1, _last_values);
-    episode->values(timestep, _current_values);
-
-    float advantage = _last_values[last_action];
-    float last_value = *std::max_element(_last_values.begin(), _last_values.end());
-    float current_value = *std::max_element(_current_values.begin(), _current_values.end());
+    float advantage = episode->value(timestep - 1, last_action);
+    float last_value = episode->maxValue(timestep - 1);
+    float current_value = episode->maxTargetValue(timestep);
 
     return
         last_value +
@@ -35,16 +35,12 @@ class AdvantageLearning : public AbstractTDLearning
          * @param kappa The smaller this factor is, the strongest the bias for
          *              better actions is.
          */
-        AdvantageLearning(float discount_factor, float eligibility_factor, float learning_rate, float kappa);
+        AdvantageLearning(float discount_factor, float eligibility_factor, float learning_rate, float kappa, Traces traces = ReplayTraces);
 
         virtual float tdError(const Episode *episode, unsigned int timestep);
 
     private:
         float _inv_kappa;
-
-        // Lists so that memory does not need to be continuously reallocated
-        std::vector<float> _last_values;
-        std::vector<float> _current_values;
 };
 
 #endif
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2015 Vrije Universiteit Brussel
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __DOUBLEQLEARNING_H__
+#define __DOUBLEQLEARNING_H__
+
+#include "qlearning.h"
+
+/**
+ * @brief Double Q-Learning, using the target values of the model
+ *
+ * The next action is chosen by the values of the model, but its value is
+ * given by the target values. This reduces the over-estimation of Q-Learning,
+ * that takes the maximum of noisy values. Without target values (see
+ * AbstractModel::targetValues()), this is equivalent to QLearning.
+ *
+ * van Hasselt et al., Deep Reinforcement Learning with Double Q-learning, 2015
+ */
+class DoubleQLearning : public QLearning
+{
+    public:
+        /**
+         * @param discount_factor Discount factor used when computing cumulative rewards
+         * @param learning_rate Rate at which learning occurs
+         * @param traces Way the TD errors are propagated to the previous time steps
+         */
+        DoubleQLearning(float discount_factor, float eligibility_factor, float learning_rate, Traces traces = ReplayTraces);
+
+        virtual float tdError(const Episode *episode, unsigned int timestep);
+};
+
+#endif
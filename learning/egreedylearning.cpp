@@ -21,13 +21,15 @@
  */
 
 #include "egreedylearning.h"
+#include <model/random.h>
 
 #include <algorithm>
 #include <numeric>
 
 EGreedyLearning::EGreedyLearning(AbstractLearning *learning, float epsilon)
 : _learning(learning),
-  _epsilon(epsilon)
+  _epsilon(epsilon),
+  _action(0)
 {
 }
 
@@ -38,20 +40,58 @@ EGreedyLearning::~EGreedyLearning()
 
 void EGreedyLearning::actions(Episode *episode, std::vector<float> &probabilities, float &td_error)
 {
+    unsigned int num_actions = episode->numActions();
+    unsigned int best_action;
 
-    // Let the wrapped learning algorithm compute the premilinary values
-    _learning->actions(episode, probabilities, td_error);
+    // Decide whether this step is exploratory. A uniformly-chosen action is
+    // taken with probability epsilon * N / (N - 1), so that every non-best
+    // action is taken with probability epsilon / (N - 1)
+    float explore = _epsilon * float(num_actions) / float(num_actions - 1);
+    float rnd = Random::local().uniform();
 
-    // Iterator to the best value
-    auto it = std::max_element(probabilities.begin(), probabilities.end());
+    if (rnd < explore) {
+        // Reuse the random number to choose the action
+        _action = std::min(num_actions - 1, (unsigned int)(rnd / explore * float(num_actions)));
+    }
+
+    if (rnd < explore && _learning->lazyUpdates()) {
+        // A lazy algorithm only updates the values of past time steps, and
+        // catches up with the skipped updates later. Its greedy work is not
+        // needed on an exploratory step, and the best action can be read from
+        // the episode
+        td_error = 0.0f;
+        best_action = episode->bestAction(episode->length() - 1);
+    } else {
+        // Let the wrapped learning algorithm compute the premilinary values
+        _learning->actions(episode, probabilities, td_error);
 
-    // All the elements have a probability epsilon/(N - 1) of being taken
-    float proba = _epsilon / float(probabilities.size() - 1);
+        best_action = std::max_element(probabilities.begin(), probabilities.end()) - probabilities.begin();
+    }
 
-    for (float &v : probabilities) {
-        v = proba;
+    if (rnd >= explore) {
+        _action = best_action;
     }
 
-    // The best element has a probability of 1-epsilon of being taken
-    *it = 1.0f - _epsilon;
+    // All the elements have a probability epsilon/(N - 1) of being taken, the
+    // best element a probability of 1-epsilon. This is the actual distribution
+    // of the actions, that AbstractWorld::run() records in the episode
+    probabilities.assign(num_actions, _epsilon / float(num_actions - 1));
+    probabilities[best_action] = 1.0f - _epsilon;
+}
+
+unsigned int EGreedyLearning::chooseAction(const std::vector<float> &probabilities)
+{
+    (void) probabilities;
+
+    return _action;
+}
+
+void EGreedyLearning::finishEpisode(Episode *episode)
+{
+    _learning->finishEpisode(episode);
+}
+
+bool EGreedyLearning::lazyUpdates() const
+{
+    return _learning->lazyUpdates();
 }
@@ -27,6 +27,18 @@
 
 /**
  * @brief Wrapper for a learning algorithm that implements the e-Greedy action selection
+ *
+ * The best action is taken with probability 1 - epsilon, the other ones with
+ * probability epsilon / (N - 1). This is implemented by drawing a single
+ * random number per time step: with probability epsilon * N / (N - 1), the
+ * step is exploratory and the action is chosen uniformly, otherwise the best
+ * action is taken. The action is then returned by chooseAction().
+ *
+ * If the wrapped learning algorithm has lazy updates, the best action is read
+ * from the episode and the wrapped algorithm is skipped on exploratory steps.
+ * Other algorithms (ReplayTraces for instance, whose updates depend on the
+ * number of times actions() is called) are always run. The returned
+ * probabilities are the same whether the wrapped algorithm is skipped or not.
  */
 class EGreedyLearning : public AbstractLearning
 {
@@ -39,10 +51,14 @@ class EGreedyLearning : public AbstractLearning
         virtual ~EGreedyLearning();
 
         virtual void actions(Episode *episode, std::vector<float> &probabilities, float &td_error);
+        virtual unsigned int chooseAction(const std::vector<float> &probabilities);
+        virtual void finishEpisode(Episode *episode);
+        virtual bool lazyUpdates() const;
 
     private:
         AbstractLearning *_learning;
         float _epsilon;
+        unsigned int _action;           /*!< @brief Action drawn by the last call to actions() */
 };
 
 #endif
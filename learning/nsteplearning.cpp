@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2015 Vrije Universiteit Brussel
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "nsteplearning.h"
+
+#include <algorithm>
+
+NStepLearning::NStepLearning(Algorithm algorithm,
+                             unsigned int window,
+                             float discount_factor,
+                             float eligibility_factor,
+                             float learning_rate,
+                             float target_epsilon)
+: AbstractTDLearning(discount_factor, eligibility_factor, learning_rate),
+  _algorithm(algorithm),
+  _window(std::max(1u, window)),
+  _target_epsilon(target_epsilon)
+{
+}
+
+void NStepLearning::actions(Episode *episode, std::vector<float> &probabilities, float &td_error)
+{
+    Episode::Traces &traces = episode->traces();
+    unsigned int last_t = episode->length() - 1;
+
+    // Update the actions whose window is now complete. traces.next_timestep - 1
+    // is the first action that has not yet been updated.
+    while (episode->length() >= 2 && traces.next_timestep - 1 + _window <= last_t) {
+        updateValue(episode, traces.next_timestep - 1, traces.next_timestep - 1 + _window);
+        traces.next_timestep += 1;
+    }
+
+    // td_error is used to tune exploration in AdaptiveSoftmax, give it the
+    // one-step error of the last action
+    td_error = (episode->length() >= 2 ? tdError(episode, last_t) : 0.0f);
+
+    // probabilities contains the values of the last state, truncated to the
+    // number of actions
+    episode->values(last_t, probabilities);
+    probabilities.resize(episode->numActions());
+}
+
+void NStepLearning::finishEpisode(Episode *episode)
+{
+    Episode::Traces &traces = episode->traces();
+    unsigned int last_t = episode->length() - 1;
+
+    // The remaining windows are truncated at the end of the episode
+    while (episode->length() >= 2 && traces.next_timestep - 1 < last_t) {
+        updateValue(episode, traces.next_timestep - 1, last_t);
+        traces.next_timestep += 1;
+    }
+}
+
+bool NStepLearning::lazyUpdates() const
+{
+    return true;
+}
+
+float NStepLearning::tdError(const Episode *episode, unsigned int timestep)
+{
+    unsigned int last_action = episode->action(timestep - 1);
+
+    return
+        episode->reward(timestep - 1) +
+        _discount_factor * expectedValue(episode, timestep) -
+        episode->value(timestep - 1, last_action);
+}
+
+void NStepLearning::updateValue(Episode *episode, unsigned int t, unsigned int end)
+{
+    // Backward pass over the window. ret is the return from time step k + 1,
+    // that bootstraps on the expected value of the target policy at the end
+    // of the window.
+    float ret = expectedValue(episode, end);
+
+    for (unsigned int k = end; k-- > t;) {
+        if (k + 1 < end && _algorithm != NStepQ) {
+            // Replace the value of the action taken at k + 1 by the return
+            // obtained after it, weighted by the trace coefficient
+            float value = episode->value(k + 1, episode->action(k + 1));
+            float c = _eligibility_factor * targetProbability(episode, k + 1);
+
+            if (_algorithm == Retrace) {
+                float mu = episode->actionProbability(k + 1);
+
+                c = _eligibility_factor * std::min(1.0f, mu > 0.0f ? targetProbability(episode, k + 1) / mu : 1.0f);
+            }
+
+            ret = expectedValue(episode, k + 1) + c * (ret - value);
+        }
+
+        ret = episode->reward(k) + _discount_factor * ret;
+    }
+
+    unsigned int action = episode->action(t);
+
+    episode->addValue(t, action, _learning_rate * (ret - episode->value(t, action)));
+}
+
+float NStepLearning::expectedValue(const Episode *episode, unsigned int t) const
+{
+    float max_value = episode->maxValue(t);
+
+    if (_target_epsilon == 0.0f) {
+        return max_value;
+    }
+
+    // The best action has a probability 1 - epsilon, the other ones share
+    // a probability epsilon
+    unsigned int num_actions = episode->numActions();
+    float sum = 0.0f;
+
+    for (unsigned int a=0; a<num_actions; ++a) {
+        sum += episode->value(t, a);
+    }
+
+    return
+        (1.0f - _target_epsilon) * max_value +
+        _target_epsilon * (sum - max_value) / float(num_actions - 1);
+}
+
+float NStepLearning::targetProbability(const Episode *episode, unsigned int t) const
+{
+    if (episode->action(t) == episode->bestAction(t)) {
+        return 1.0f - _target_epsilon;
+    } else {
+        return _target_epsilon / float(episode->numActions() - 1);
+    }
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2015 Vrije Universiteit Brussel
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __NSTEPLEARNING_H__
+#define __NSTEPLEARNING_H__
+
+#include "abstracttdlearning.h"
+
+/**
+ * @brief Multi-step off-policy Q-Learning: n-step Q, Tree-Backup and Retrace(lambda)
+ *
+ * The value of the action taken at time t is updated once, when the n next
+ * time steps are known (or at the end of the episode), towards a return
+ * computed in one backward pass over these n time steps. The returns bootstrap
+ * on the expected value of a target policy, that takes the best action with
+ * probability 1 - target_epsilon and the other ones with probability
+ * target_epsilon / (N - 1).
+ *
+ * - n-step Q sums the rewards of the n time steps, without any off-policy
+ *   correction.
+ * - Tree-Backup weights the return of every following time step by the
+ *   probability c = lambda * pi(a) of its action under the target policy.
+ * - Retrace uses c = lambda * min(1, pi(a) / mu(a)), mu(a) being the probability
+ *   of the action under the behavior policy, stored in the episode.
+ *
+ * Munos et al., Safe and Efficient Off-Policy Reinforcement Learning, 2016
+ */
+class NStepLearning : public AbstractTDLearning
+{
+    public:
+        enum Algorithm {
+            NStepQ,
+            TreeBackup,
+            Retrace
+        };
+
+        /**
+         * @param algorithm Algorithm used to compute the returns
+         * @param window Number of time steps over which a return is computed
+         * @param discount_factor Discount factor used when computing cumulative rewards
+         * @param eligibility_factor Lambda of Tree-Backup and Retrace
+         * @param learning_rate Rate at which learning occurs
+         * @param target_epsilon Exploration of the target policy, 0 for a greedy policy
+         */
+        NStepLearning(Algorithm algorithm,
+                      unsigned int window,
+                      float discount_factor,
+                      float eligibility_factor,
+                      float learning_rate,
+                      float target_epsilon = 0.0f);
+
+        virtual void actions(Episode *episode, std::vector<float> &probabilities, float &td_error);
+
+        /**
+         * @brief Update the values of the time steps whose window was not yet
+         *        complete when the episode ended.
+         */
+        virtual void finishEpisode(Episode *episode);
+
+        /**
+         * @brief The updates of skipped time steps are applied by the next call
+         *        to actions() or finishEpisode().
+         */
+        virtual bool lazyUpdates() const;
+
+        /**
+         * @brief One-step TD error, bootstrapping on the expected value of the
+         *        target policy
+         */
+        virtual float tdError(const Episode *episode, unsigned int timestep);
+
+    private:
+        /**
+         * @brief Move the value of the action taken at time step @p t towards
+         *        the return computed over time steps t to @p end.
+         */
+        void updateValue(Episode *episode, unsigned int t, unsigned int end);
+
+        /**
+         * @brief Expected value of the target policy at a time step
+         */
+        float expectedValue(const Episode *episode, unsigned int t) const;
+
+        /**
+         * @brief Probability of the action taken at a time step under the
+         *        target policy
+         */
+        float targetProbability(const Episode *episode, unsigned int t) const;
+
+    private:
+        Algorithm _algorithm;
+        unsigned int _window;
+        float _target_epsilon;
+};
+
+#endif
@@ -22,10 +22,8 @@
 
 #include "qlearning.h"
 
-#include <algorithm>
-
-QLearning::QLearning(float discount_factor, float eligibility_factor, float learning_rate)
-: AbstractTDLearning(discount_factor, eligibility_factor, learning_rate)
+QLearning::QLearning(float discount_factor, float eligibility_factor, float learning_rate, Traces traces)
+: AbstractTDLearning(discount_factor, eligibility_factor, learning_rate, traces)
 {
 }
 
@@ -34,13 +32,11 @@ float QLearning::tdError(const Episode *episode, unsigned int timestep)
     unsigned int last_action = episode->action(timestep - 1);
     float last_reward = episode->reward(timestep - 1);
 
-    episode->values(timestep - 1, _last_values);
-    episode->values(timestep, _current_values);
-
-    float Q = _last_values[last_action];
+    float Q = episode->value(timestep - 1, last_action);
 
+    // Bootstrap on the target values if the model provides them
     return
         last_reward +
-        _discount_factor * *std::max_element(_current_values.begin(), _current_values.end())
+        _discount_factor * episode->maxTargetValue(timestep)
         - Q;
 }
@@ -34,15 +34,11 @@ class QLearning : public AbstractTDLearning
         /**
          * @param discount_factor Discount factor used when computing cumulative rewards
          * @param learning_rate Rate at which learning occurs
+         * @param traces Way the TD errors are propagated to the previous time steps
          */
-        QLearning(float discount_factor, float eligibility_factor, float learning_rate);
+        QLearning(float discount_factor, float eligibility_factor, float learning_rate, Traces traces = ReplayTraces);
 
         virtual float tdError(const Episode *episode, unsigned int timestep);
-
-    private:
-        // Lists so that memory does not need to be continuously reallocated
-        std::vector<float> _last_values;
-        std::vector<float> _current_values;
 };
 
 #endif
@@ -24,6 +24,7 @@
 
 #include <nnetcpp/activation.h>
 
+#include <algorithm>
 #include <cmath>
 #include <numeric>
 
@@ -39,9 +40,13 @@ void SoftmaxLearning::actions(Episode *episode, std::vector<float> &probabilitie
     _learning->actions(episode, probabilities, td_error);
     _temperature = adjustTemperature(episode, td_error);
 
-    // Take the exponentials of all those values
+    // Take the exponentials of all those values. Subtracting the largest value
+    // does not change the probabilities, but keeps the exponentials between
+    // 0 and 1 so that they cannot overflow
+    float max_value = *std::max_element(probabilities.begin(), probabilities.end());
+
     for (float &v : probabilities) {
-        v = nnetcppinternal::_exp(v / _temperature);
+        v = nnetcppinternal::_exp((v - max_value) / _temperature);
     }
 
     float sum = std::accumulate(probabilities.begin(), probabilities.end(), 0.0f);
@@ -60,3 +65,14 @@ float SoftmaxLearning::adjustTemperature(Episode *episode, float td_error)
     // By default, use a fixed temperature
     return _temperature;
 }
+
+void SoftmaxLearning::finishEpisode(Episode *episode)
+{
+    _learning->finishEpisode(episode);
+}
+
+bool SoftmaxLearning::lazyUpdates() const
+{
+    // Softmax needs the values at every time step
+    return false;
+}
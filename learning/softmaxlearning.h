@@ -38,6 +38,8 @@ class SoftmaxLearning : public AbstractLearning
         SoftmaxLearning(AbstractLearning *learning, float temperature);
 
         virtual void actions(Episode *episode, std::vector<float> &probabilities, float &td_error);
+        virtual void finishEpisode(Episode *episode);
+        virtual bool lazyUpdates() const;
 
     protected:
         /**
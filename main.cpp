@@ -21,10 +21,13 @@
  */
 
 #include "learning/qlearning.h"
+#include "learning/doubleqlearning.h"
 #include "learning/advantagelearning.h"
+#include "learning/nsteplearning.h"
 #include "learning/softmaxlearning.h"
 #include "learning/adaptivesoftmaxlearning.h"
 #include "learning/egreedylearning.h"
+#include "model/random.h"
 #include "model/tablemodel.h"
 #include "model/gaussianmixturemodel.h"
 #include "model/fusionartmodel.h"
@@ -62,9 +65,24 @@ unsigned int hidden_neurons = 50;
 unsigned int batch_size = 10;
 unsigned int rollout_length = 1000;
 unsigned int num_rollouts = 1;
+unsigned int nstep_window = 10;
+unsigned int target_refresh = 0;
 float discount_factor = 0.9f;
 float eligibility_factor = 0.9f;
 float learning_factor = 0.2f;
+float target_epsilon = 0.0f;
+AbstractTDLearning::Traces traces = AbstractTDLearning::ReplayTraces;
+AdaptiveSoftmaxLearning::Estimator temperature_estimator = AdaptiveSoftmaxLearning::ModelEstimator;
+
+/**
+ * @brief Model and learning algorithm built from the command line
+ */
+struct Agent {
+    AbstractModel *model;
+    AbstractModel *world_model;
+    AbstractLearning *learning;
+    AbstractLearning *rollout_learning;
+};
 
 /**
  * @brief One-of-n encoder for 16 distinct values per state variable
@@ -105,23 +123,80 @@ int main(int argc, char **argv) {
 
     // Enable FPU exceptions so that NaN and infinites can be traced back
     feenableexcept(FE_INVALID);
-    srand(time(nullptr));
 
-    AbstractWorld *world = nullptr;
-    AbstractModel *model = nullptr;
-    AbstractModel *world_model = nullptr;
-    AbstractLearning *learning = nullptr;
-    AbstractLearning *rollout_learning = nullptr;
-    Episode::Encoder encoder = nullptr;
+    // Parse the options before any component is created, so that they apply
+    // to all the components whatever their position on the command line. The
+    // random number generators are also seeded before any component is
+    // created, as components may draw random numbers in their constructor.
+    // seed=N makes the run reproducible.
+    unsigned long long seed = time(nullptr);
     bool random_initial = false;
+    Episode::Encoder encoder = nullptr;
+    std::string load_filename;
+    std::string save_filename;
 
     for (int i=1; i<argc; ++i) {
         std::string arg(argv[i]);
 
         if (arg == "randominitial") {
             random_initial = true;
+        } else if (arg == "onlinetraces") {
+            traces = AbstractTDLearning::OnlineTraces;
+        } else if (arg == "deferredtraces") {
+            traces = AbstractTDLearning::DeferredTraces;
+        } else if (arg == "globaltemperature") {
+            temperature_estimator = AdaptiveSoftmaxLearning::GlobalEstimator;
+        } else if (arg == "hashedtemperature") {
+            temperature_estimator = AdaptiveSoftmaxLearning::HashedStateEstimator;
+        } else if (arg == "targetnetwork") {
+            target_refresh = 10;
         } else if (arg == "oneofn") {
             encoder = &oneOfNEncoder;
+        } else if (arg.compare(0, 5, "load=") == 0) {
+            load_filename = arg.substr(5);
+        } else if (arg.compare(0, 5, "save=") == 0) {
+            save_filename = arg.substr(5);
+        } else if (arg.compare(0, 5, "seed=") == 0) {
+            seed = std::stoull(arg.substr(5));
+        } else if (arg.compare(0, 12, "nstepwindow=") == 0) {
+            nstep_window = std::stoul(arg.substr(12));
+        } else if (arg.compare(0, 14, "targetepsilon=") == 0) {
+            target_epsilon = std::stof(arg.substr(14));
+        }
+    }
+
+    // Print the seed so that any run can be reproduced with seed=N
+    std::cerr << "Seed: " << seed << std::endl;
+
+    srand(seed);
+    Random::setSeed(seed);
+
+    AbstractWorld *world = nullptr;
+    AbstractModel *model = nullptr;
+    AbstractModel *world_model = nullptr;
+    AbstractLearning *learning = nullptr;
+    AbstractLearning *rollout_learning = nullptr;
+    std::vector<Agent> agents;
+
+    // Build the world, the models and the learning algorithms, in the order
+    // given on the command line
+    for (int i=1; i<argc; ++i) {
+        std::string arg(argv[i]);
+
+        if (arg == "follow") {
+            // The model and learning algorithm given so far are complete, the
+            // next ones will learn from the episodes of the first agent
+            if (model == nullptr || rollout_learning == nullptr) {
+                std::cerr << "Put follow after a model and a learning algorithm" << std::endl;
+                return 1;
+            }
+
+            agents.push_back({model, world_model, learning, rollout_learning});
+
+            model = nullptr;
+            world_model = nullptr;
+            learning = nullptr;
+            rollout_learning = nullptr;
         } else if (arg == "tmaze") {
             num_episodes = 50000;
             discount_factor = 0.98f;
@@ -188,10 +263,14 @@ int main(int argc, char **argv) {
             model = new PSRModel(5, 5, 10, 100);
             world_model = new PSRModel(5, 5, 10, 100);
         } else if (arg == "perceptron") {
-            model = new PerceptronModel(hidden_neurons);
-            world_model = new PerceptronModel(hidden_neurons);
+            model = new PerceptronModel(hidden_neurons, target_refresh);
+            world_model = new PerceptronModel(hidden_neurons, target_refresh);
 
-            eligibility_factor = 0.0f;                          // NOTE: Eligibility traces tend to propagate approximation errors, and thus don't work well with neural networks
+            // A target network keeps approximation errors from feeding back
+            // into the bootstrapped values, eligibility traces can then be kept
+            if (target_refresh == 0) {
+                eligibility_factor = 0.0f;                      // NOTE: Eligibility traces tend to propagate approximation errors, and thus don't work well with neural networks
+            }
         } else if (arg == "stackedgru") {
             model = new StackedGRUModel(hidden_neurons);
             world_model = new StackedGRUModel(hidden_neurons);
@@ -202,11 +281,21 @@ int main(int argc, char **argv) {
             model = new StackedLSTMModel(hidden_neurons);
             world_model = new StackedLSTMModel(hidden_neurons);
         } else if (arg == "qlearning") {
-            rollout_learning = new QLearning(discount_factor, eligibility_factor, learning_factor);
-            learning = new QLearning(discount_factor, eligibility_factor, learning_factor);
+            rollout_learning = new QLearning(discount_factor, eligibility_factor, learning_factor, traces);
+            learning = new QLearning(discount_factor, eligibility_factor, learning_factor, traces);
+        } else if (arg == "doubleq") {
+            rollout_learning = new DoubleQLearning(discount_factor, eligibility_factor, learning_factor, traces);
+            learning = new DoubleQLearning(discount_factor, eligibility_factor, learning_factor, traces);
         } else if (arg == "advantage") {
-            rollout_learning = new AdvantageLearning(discount_factor, eligibility_factor, learning_factor, 0.5);
-            learning = new AdvantageLearning(discount_factor, eligibility_factor, learning_factor, 0.5);
+            rollout_learning = new AdvantageLearning(discount_factor, eligibility_factor, learning_factor, 0.5, traces);
+            learning = new AdvantageLearning(discount_factor, eligibility_factor, learning_factor, 0.5, traces);
+        } else if (arg == "nstepq" || arg == "treebackup" || arg == "retrace") {
+            NStepLearning::Algorithm algorithm =
+                (arg == "nstepq" ? NStepLearning::NStepQ :
+                (arg == "treebackup" ? NStepLearning::TreeBackup : NStepLearning::Retrace));
+
+            rollout_learning = new NStepLearning(algorithm, nstep_window, discount_factor, eligibility_factor, learning_factor, target_epsilon);
+            learning = new NStepLearning(algorithm, nstep_window, discount_factor, eligibility_factor, learning_factor, target_epsilon);
         } else if (arg == "softmax") {
             if (learning == nullptr) {
                 std::cerr << "Put softmax after the learning algorithm to be filtered" << std::endl;
@@ -221,8 +310,8 @@ int main(int argc, char **argv) {
                 return 1;
             }
 
-            rollout_learning = new AdaptiveSoftmaxLearning(rollout_learning, 0.1);
-            learning = new AdaptiveSoftmaxLearning(learning, 0.05);
+            rollout_learning = new AdaptiveSoftmaxLearning(rollout_learning, 0.1, temperature_estimator);
+            learning = new AdaptiveSoftmaxLearning(learning, 0.05, temperature_estimator);
         } else if (arg == "egreedy") {
             if (learning == nullptr) {
                 std::cerr << "Put egreedy after the learning algorithm to be filtered" << std::endl;
@@ -268,24 +357,84 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    agents.push_back({model, world_model, learning, rollout_learning});
+
+    // Load and save the categories of a FusionART model, so that a run can
+    // start from what a previous one has learned
+    FusionARTModel *fusionart_model = dynamic_cast<FusionARTModel *>(agents[0].model);
+
+    if ((!load_filename.empty() || !save_filename.empty()) && fusionart_model == nullptr) {
+        std::cerr << "load= and save= can only be used with the fusionart model" << std::endl;
+        return 1;
+    }
+
+    if (!load_filename.empty()) {
+        // An episode having only the initial state gives the sizes of the
+        // states and values that the model will see
+        Episode episode(agents[0].learning->valueSize(world->numActions()), world->numActions(), encoder);
+        std::vector<float> state;
+
+        world->reset();
+        world->initialState(state);
+        episode.addState(state);
+
+        if (!fusionart_model->load(load_filename, episode.encodedStateSize(), episode.valueSize())) {
+            std::cerr << "Cannot load " << load_filename << ", or it has been saved in another world" << std::endl;
+            return 1;
+        }
+    }
+
+    // The first agent acts in the world, the other ones learn from its episodes
+    std::vector<AbstractWorld::Follower> followers(agents.size() - 1);
+
+    for (std::size_t i=1; i<agents.size(); ++i) {
+        followers[i - 1].model = agents[i].model;
+        followers[i - 1].learning = agents[i].learning;
+    }
+
     // Simulate the world
-    std::vector<Episode *> episodes = world->run(model, learning, num_episodes, max_timesteps, batch_size, encoder);
+    std::vector<Episode *> episodes = world->run(agents[0].model, agents[0].learning, num_episodes, max_timesteps, batch_size, encoder, true, nullptr, &followers);
 
-    // Output statistics in a file that can be plotted using gnuplot
+    // Output statistics in a file that can be plotted using gnuplot. The
+    // followers share the rewards of the first agent, so the value of the
+    // initial state estimated by every agent is also given.
     std::ofstream stream("rewards.dat");
 
     for (std::size_t e=0; e<episodes.size(); ++e) {
-        stream << e << '\t' << episodes[e]->cumulativeReward() << std::endl;
+        stream << e << '\t' << episodes[e]->cumulativeReward();
+
+        if (!followers.empty()) {
+            stream << '\t' << episodes[e]->maxValue(0);
+
+            for (AbstractWorld::Follower &follower : followers) {
+                stream << '\t' << follower.episodes[e]->maxValue(0);
+            }
+        }
+
+        stream << std::endl;
 
         delete episodes[e];
     }
 
+    for (AbstractWorld::Follower &follower : followers) {
+        for (Episode *episode : follower.episodes) {
+            delete episode;
+        }
+    }
+
+    if (!save_filename.empty() && !fusionart_model->save(save_filename)) {
+        std::cerr << "Cannot save the model to " << save_filename << std::endl;
+    }
+
     // Plot the model
-    world->plotModel(model, encoder);
+    world->plotModel(agents[0].model, encoder);
+
+    for (Agent &agent : agents) {
+        delete agent.model;
+        delete agent.world_model;
+        delete agent.learning;
+        delete agent.rollout_learning;
+    }
 
-    delete model;
-    delete world_model;
-    delete learning;
-    delete rollout_learning;
     delete world;
 }
@@ -55,6 +55,28 @@ class AbstractModel
          */
         virtual void values(Episode *episode, std::vector<float> &rs) = 0;
 
+        /**
+         * @brief Return the action values of the last state of @p episode,
+         *        as predicted by a target model
+         *
+         * A target model is a copy of the model that is frozen during several
+         * calls to learn(), so that the values towards which learning
+         * algorithms bootstrap do not move every time the model learns.
+         *
+         * @return False if this model has no target model, in which case
+         *         @p rs is left untouched. A model must either always or never
+         *         return true.
+         *
+         * @warning This method must be thread-safe, like values().
+         */
+        virtual bool targetValues(Episode *episode, std::vector<float> &rs)
+        {
+            (void) episode;
+            (void) rs;
+
+            return false;
+        }
+
         /**
          * @brief Tell the model to swap its training and prediction internal models
          *
@@ -74,6 +74,26 @@ void Episode::addValues(const std::vector<float> &values)
 {
     assert(values.size() == _value_size);
     extend(_values, values);
+
+    _max_values.push_back(0.0f);
+    _best_actions.push_back(0);
+    _max_valid.push_back(false);
+}
+
+void Episode::addTargetValues(const std::vector<float> &values)
+{
+    assert(values.size() == _value_size);
+    assert(_values.size() >= _target_values.size() + _value_size);
+
+    // The target values are the ones of the last time step. The previous
+    // time steps for which no target values were added use their values.
+    std::size_t last_row = _values.size() - _value_size;
+
+    if (_target_values.size() < last_row) {
+        _target_values.insert(_target_values.end(), _values.begin() + _target_values.size(), _values.begin() + last_row);
+    }
+
+    extend(_target_values, values);
 }
 
 void Episode::addReward(float reward)
@@ -81,9 +101,10 @@ void Episode::addReward(float reward)
     _rewards.push_back(reward);
 }
 
-void Episode::addAction(int action)
+void Episode::addAction(int action, float probability)
 {
     _actions.push_back(action);
+    _action_probabilities.push_back(probability);
 }
 
 void Episode::setAborted(bool aborted)
@@ -94,11 +115,16 @@ void Episode::setAborted(bool aborted)
 void Episode::copyValues(const Episode &other)
 {
     _values = other._values;
+    _target_values = other._target_values;
+    _max_values = other._max_values;
+    _best_actions = other._best_actions;
+    _max_valid = other._max_valid;
 }
 
 void Episode::copyActions(const Episode &other)
 {
     _actions = other._actions;
+    _action_probabilities = other._action_probabilities;
 }
 
 void Episode::copyRewards(const Episode &other)
@@ -164,14 +190,79 @@ void Episode::values(unsigned int t, std::vector<float> &rs) const
     extract(_values, _value_size, t, rs);
 }
 
+float Episode::value(unsigned int t, unsigned int action) const
+{
+    return _values[t * _value_size + action];
+}
+
+float Episode::maxValue(unsigned int t) const
+{
+    updateMaxValue(t);
+
+    return _max_values[t];
+}
+
+unsigned int Episode::bestAction(unsigned int t) const
+{
+    updateMaxValue(t);
+
+    return _best_actions[t];
+}
+
+float Episode::targetValue(unsigned int t, unsigned int action) const
+{
+    if (!hasTargetValues(t)) {
+        return value(t, action);
+    }
+
+    return _target_values[t * _value_size + action];
+}
+
+float Episode::maxTargetValue(unsigned int t) const
+{
+    if (!hasTargetValues(t)) {
+        return maxValue(t);
+    }
+
+    const float *row = _target_values.data() + t * _value_size;
+
+    return *std::max_element(row, row + _num_actions);
+}
+
+bool Episode::hasTargetValues(unsigned int t) const
+{
+    return _target_values.size() >= (t + 1) * _value_size;
+}
+
+void Episode::updateMaxValue(unsigned int t) const
+{
+    if (_max_valid[t]) {
+        return;
+    }
+
+    const float *row = _values.data() + t * _value_size;
+    const float *best = std::max_element(row, row + _num_actions);
+
+    _max_values[t] = *best;
+    _best_actions[t] = best - row;
+    _max_valid[t] = true;
+}
+
 void Episode::addValue(unsigned int t, unsigned int action, float value)
 {
     _values[t * _value_size + action] += value;
+    _max_valid[t] = false;
 }
 
 void Episode::updateValue(unsigned int t, unsigned int action, float value)
 {
     _values[t * _value_size + action] = value;
+    _max_valid[t] = false;
+}
+
+Episode::Traces &Episode::traces()
+{
+    return _traces;
 }
 
 float Episode::reward(unsigned int t) const
@@ -188,3 +279,8 @@ float Episode::action(unsigned int t) const
 {
     return _actions[t];
 }
+
+float Episode::actionProbability(unsigned int t) const
+{
+    return _action_probabilities[t];
+}
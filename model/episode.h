@@ -24,6 +24,7 @@
 #define __EPISODE_H__
 
 #include <vector>
+#include <deque>
 
 /**
  * @brief List of states, actions, values and rewards.
@@ -41,6 +42,26 @@ class Episode
     public:
         typedef void (*Encoder)(std::vector<float> &state);
 
+        /**
+         * @brief Eligibility trace of the value of an action at a time step
+         */
+        struct Trace {
+            unsigned int t;
+            unsigned int action;
+            float eligibility;
+        };
+
+        /**
+         * @brief Eligibility traces maintained by online TD learning while the
+         *        episode grows.
+         */
+        struct Traces {
+            std::deque<Trace> active;       /*!< @brief Traces still eligible, oldest first */
+            unsigned int next_timestep;     /*!< @brief First time step whose TD error has not yet been applied to the traces */
+
+            Traces() : next_timestep(1) {}
+        };
+
         /**
          * @brief Constructor
          *
@@ -68,6 +89,17 @@ class Episode
          */
         void addValues(const std::vector<float> &values);
 
+        /**
+         * @brief Add a tuple of values predicted by a target model to the episode
+         *
+         * Models that keep a frozen copy of themselves (see
+         * AbstractModel::targetValues()) provide these values in addition to
+         * the ones given to addValues(). They belong to the last time step
+         * added with addValues(), the previous time steps without target
+         * values receiving a copy of their values.
+         */
+        void addTargetValues(const std::vector<float> &values);
+
         /**
          * @brief Add a reward to the episode
          */
@@ -75,8 +107,12 @@ class Episode
 
         /**
          * @brief Add an action to the episode
+         *
+         * @param probability Probability with which the action has been chosen
+         *                    by the behavior policy, used by off-policy learning
+         *                    algorithms. 1 if unknown.
          */
-        void addAction(int action);
+        void addAction(int action, float probability = 1.0f);
 
         /**
          * @brief Set whether the episode has ended because the maximum time steps
@@ -145,6 +181,41 @@ class Episode
          */
         void values(unsigned int t, std::vector<float> &rs) const;
 
+        /**
+         * @brief Value of an action at a given time step, without copying the
+         *        values of the time step
+         */
+        float value(unsigned int t, unsigned int action) const;
+
+        /**
+         * @brief Highest action value at a given time step
+         *
+         * Only the values of the actions are considered, not the additional
+         * values that learning algorithms may store (see valueSize()). The
+         * maximum is cached until the values of the time step are modified.
+         */
+        float maxValue(unsigned int t) const;
+
+        /**
+         * @brief Action having the highest value at a given time step
+         */
+        unsigned int bestAction(unsigned int t) const;
+
+        /**
+         * @brief Value of an action at a given time step, as predicted by the
+         *        target model.
+         *
+         * If no target values have been added to this episode for time step
+         * @p t, value() is returned.
+         */
+        float targetValue(unsigned int t, unsigned int action) const;
+
+        /**
+         * @brief Highest target value of an action at a given time step, or
+         *        maxValue() if no target values have been added for it.
+         */
+        float maxTargetValue(unsigned int t) const;
+
         /**
          * @brief Add a value to the value of an action
          */
@@ -155,6 +226,11 @@ class Episode
          */
         void updateValue(unsigned int t, unsigned int action, float value);
 
+        /**
+         * @brief Eligibility traces of the values of this episode
+         */
+        Traces &traces();
+
         /**
          * @brief Reward at a given time step
          */
@@ -170,11 +246,35 @@ class Episode
          */
         float action(unsigned int t) const;
 
+        /**
+         * @brief Probability with which the action at a given time step has
+         *        been chosen
+         */
+        float actionProbability(unsigned int t) const;
+
+    private:
+        /**
+         * @brief Update the cached maximum value of a time step, if needed
+         */
+        void updateMaxValue(unsigned int t) const;
+
+        /**
+         * @brief Whether target values have been added for time step @p t
+         */
+        bool hasTargetValues(unsigned int t) const;
+
     private:
         std::vector<float> _states;
         std::vector<float> _values;
+        std::vector<float> _target_values;             /*!< @brief Values predicted by the target model, empty if there is no target model */
+        mutable std::vector<float> _max_values;         /*!< @brief Cached maximum action value of every time step */
+        mutable std::vector<unsigned int> _best_actions;    /*!< @brief Cached action having the maximum value at every time step */
+        mutable std::vector<char> _max_valid;           /*!< @brief Whether the cached maximum of a time step is up to date */
         std::vector<float> _rewards;
         std::vector<int> _actions;
+        std::vector<float> _action_probabilities;
+
+        Traces _traces;
 
         Encoder _encoder;
 
@@ -24,6 +24,7 @@
 #include "episode.h"
 
 #include <algorithm>
+#include <fstream>
 
 FusionARTModel::FusionARTModel(bool mask_actions)
 : _mask_actions(mask_actions),
@@ -32,6 +33,13 @@ FusionARTModel::FusionARTModel(bool mask_actions)
 {
 }
 
+FusionARTModel::Model::Model()
+{
+    model.addPort(&state);
+    model.addPort(&action);
+    model.addPort(&value);
+}
+
 FusionARTModel::~FusionARTModel()
 {
     if (_learning_model) {
@@ -58,29 +66,25 @@ void FusionARTModel::values(Episode *episode, std::vector<float> &rs)
     } else {
         std::unique_lock<std::mutex> lock(_mutex);
 
-        // Put the state somewhere, it will be used for predicting the value of each action
+        // Put the state in the state port, and clear the value port
         episode->encodedState(episode->length() - 1, _state);
+        vectorToArrayXf(_state, _prediction_model->state.value);
 
-        // Predict the value of all the actions
-        rs.resize(episode->valueSize());
-
-        for (unsigned int a=0; a<episode->valueSize(); ++a) {
-            // Put the last state in the state port (that is overwritten by every
-            // call to run()).
-            vectorToArrayXf(_state, _prediction_model->state.value);
-
-            // One-hot encoding of the action
-            _prediction_model->action.value.setZero();
-            _prediction_model->action.value(a) = 1.0f;
+        _prediction_model->value.value.setOnes();
 
-            // Clear the value port
-            _prediction_model->value.value.setOnes();
+        // Predict the value of all the actions in a single scan of the patterns,
+        // the action port receiving the one-hot encoding of every action
+        _prediction_model->model.runOneHot(
+            &_prediction_model->action,
+            &_prediction_model->value,
+            _outputs
+        );
 
-            // Run the model without learning
-            _prediction_model->model.run(false);
+        rs.resize(episode->valueSize());
 
+        for (unsigned int a=0; a<episode->valueSize(); ++a) {
             // v0 / v1 gives the value, v2 - v3 gives the sign
-            Eigen::ArrayXf &value = _prediction_model->value.value;
+            const Eigen::ArrayXf &value = _outputs[a];
 
             rs[a] = (value(2) - value(3)) * value(0) / value(1);
         }
@@ -96,10 +100,6 @@ void FusionARTModel::learn(const std::vector<Episode *> &episodes)
     if (!_learning_model) {
         _learning_model = new Model;
 
-        _learning_model->model.addPort(&_learning_model->state);
-        _learning_model->model.addPort(&_learning_model->action);
-        _learning_model->model.addPort(&_learning_model->value);
-
         _learning_model->state.value.resize(episodes[0]->encodedStateSize());
         _learning_model->state.weight = 0.5f;
         _learning_model->state.vigilence = 0.6f;
@@ -113,9 +113,10 @@ void FusionARTModel::learn(const std::vector<Episode *> &episodes)
 
     if (_prediction_model) {
         // Synchronize the learning model with the prediction model so that learning
-        // builds on up-to-date data.
-        std::unique_lock<std::mutex> lock(_mutex);
-
+        // builds on up-to-date data. Only the patterns changed since the last
+        // swap are copied. The patterns of the prediction model are never
+        // modified by values(), and swapModels() is not called during learn(),
+        // so values() does not need to be blocked during the copy.
         _learning_model->model.copyFrom(_prediction_model->model);
     }
 
@@ -170,6 +171,64 @@ void FusionARTModel::learn(const std::vector<Episode *> &episodes)
     }
 }
 
+bool FusionARTModel::save(const std::string &filename)
+{
+    // Prevent swapModels() from changing the prediction model while it is saved
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (!_prediction_model) {
+        return false;
+    }
+
+    std::ofstream stream(filename, std::ios::binary);
+
+    return _prediction_model->model.save(stream);
+}
+
+bool FusionARTModel::load(const std::string &filename, unsigned int state_size, unsigned int value_size)
+{
+    std::ifstream stream(filename, std::ios::binary);
+    Model *prediction_model = new Model;
+    Model *learning_model = new Model;
+
+    // Load the file in both models. They are new, so the loaded patterns get
+    // the same versions and the next copyFrom() copies nothing.
+    bool ok = prediction_model->model.load(stream);
+
+    if (ok) {
+        stream.clear();
+        stream.seekg(0);
+
+        ok = learning_model->model.load(stream);
+    }
+
+    // The file must have been produced in a world having the same states and
+    // actions, with the value encoding used by learn()
+    if (ok) {
+        ok =
+            prediction_model->state.value.rows() == state_size &&
+            prediction_model->action.value.rows() == value_size &&
+            prediction_model->value.value.rows() == 4;
+    }
+
+    if (!ok) {
+        delete prediction_model;
+        delete learning_model;
+
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    delete _prediction_model;
+    delete _learning_model;
+
+    _prediction_model = prediction_model;
+    _learning_model = learning_model;
+
+    return true;
+}
+
 void FusionARTModel::vectorToArrayXf(const std::vector<float> &stl, Eigen::ArrayXf &eigen)
 {
     for (std::size_t i=0; i<stl.size(); ++i) {
@@ -27,6 +27,7 @@
 #include "functionapproximators/fusionart.h"
 
 #include <mutex>
+#include <string>
 
 /**
  * @brief Model built on FusionART.
@@ -47,8 +48,30 @@ class FusionARTModel : public AbstractModel
         virtual void learn(const std::vector<Episode *> &episodes);
         virtual void swapModels();
 
-    private:
-        void vectorToArrayXf(const std::vector<float> &stl, Eigen::ArrayXf &eigen);
+        /**
+         * @brief Save the categories learned by the prediction model to a file
+         *
+         * @return False if there is no prediction model yet or if the file
+         *         could not be written.
+         */
+        bool save(const std::string &filename);
+
+        /**
+         * @brief Load categories saved by save(), replacing the ones of this
+         *        model.
+         *
+         * Both the learning and the prediction models are loaded, so that
+         * values() immediately uses the loaded categories and learning builds
+         * on them. Must not be called concurrently with learn().
+         *
+         * @param state_size Size of the encoded states of the episodes that
+         *                   will be given to this model
+         * @param value_size Number of values per state of these episodes
+         *
+         * @return False if the file could not be read, is invalid, or has
+         *         been saved by a model having other state or value sizes.
+         */
+        bool load(const std::string &filename, unsigned int state_size, unsigned int value_size);
 
     private:
         struct Model {
@@ -56,12 +79,17 @@ class FusionARTModel : public AbstractModel
             FusionART::Port state;
             FusionART::Port action;
             FusionART::Port value;
+
+            Model();
         };
 
+        void vectorToArrayXf(const std::vector<float> &stl, Eigen::ArrayXf &eigen);
+
         std::mutex _mutex;
 
         bool _mask_actions;
         std::vector<float> _state;
+        std::vector<Eigen::ArrayXf> _outputs;
 
         Model *_prediction_model;
         Model *_learning_model;
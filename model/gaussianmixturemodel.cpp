@@ -22,22 +22,51 @@
 
 #include "gaussianmixturemodel.h"
 #include "episode.h"
+#include "random.h"
 #include "functionapproximators/gaussianmixture.h"
 
 #include <algorithm>
 #include <random>
 #include <iostream>
 
-GaussianMixtureModel::GaussianMixtureModel(float var_initial, float novelty, float noise, bool mask_actions)
+GaussianMixtureModel::GaussianMixtureModel(float var_initial, float novelty, float noise, bool mask_actions, unsigned int max_clusters)
 : _var_initial(var_initial),
   _novelty(novelty),
   _mask_actions(mask_actions),
-  _noise_distribution(0.0f, noise)
+  _max_clusters(max_clusters),
+  _noise_distribution(0.0f, noise),
+  _random_engine(Random::local().next()),
+  _job_running(false),
+  _work_task(nullptr),
+  _work_generation(0),
+  _num_tasks(0),
+  _next_task(0),
+  _pending_tasks(0),
+  _finish(false)
 {
+    // Workers that help the thread calling learn() or values()
+    unsigned int num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned int i=1; i<num_threads; ++i) {
+        _workers.push_back(std::thread(&GaussianMixtureModel::workerThread, this));
+    }
 }
 
 GaussianMixtureModel::~GaussianMixtureModel()
 {
+    // Tell the workers that they should finish, and join them
+    {
+        std::unique_lock<std::mutex> lock(_work_mutex);
+
+        _finish = true;
+    }
+
+    _work_cond.notify_all();
+
+    for (std::thread &worker : _workers) {
+        worker.join();
+    }
+
     // Delete all the models
     for (GaussianMixture *model : _models) {
         delete model;
@@ -79,8 +108,19 @@ void GaussianMixtureModel::values(Episode *episode, std::vector<float> &rs)
         // Pass this input to all the models
         rs.resize(episode->valueSize());
 
-        for (std::size_t i=0; i<rs.size(); ++i) {
-            rs[i] = _models[i]->value(input);
+        if (_mask_actions) {
+            for (std::size_t i=0; i<rs.size(); ++i) {
+                rs[i] = _models[i]->value(input);
+            }
+        } else {
+            // Values of all the actions in one pass
+            Eigen::VectorXf output = Eigen::VectorXf::Zero(rs.size());
+
+            _models[0]->values(input, output);
+
+            for (std::size_t i=0; i<rs.size(); ++i) {
+                rs[i] = output(i);
+            }
         }
     }
 }
@@ -89,13 +129,16 @@ void GaussianMixtureModel::learn(const std::vector<Episode *> &episodes)
 {
     std::vector<float> state;
     std::vector<float> values;
+    std::vector<Sample> samples;
 
     for (Episode *episode : episodes) {
-        Eigen::VectorXf input(episode->stateSize());
-
-        // Create the models if needed
+        // Create the models if needed. When actions are not masked, all the
+        // values are learned at every state, and a single mixture with one
+        // output per value shares its clusters among all the values.
         if (_learn_models.size() == 0) {
-            for (unsigned int a=0; a<episode->valueSize(); ++a) {
+            unsigned int num_models = (_mask_actions ? episode->valueSize() : 1);
+
+            for (unsigned int a=0; a<num_models; ++a) {
                 if (_models.size() == 0) {
                     // Completely new model, first time learn() is called
                     _learn_models.push_back(new GaussianMixture(_var_initial, _novelty));
@@ -103,30 +146,43 @@ void GaussianMixtureModel::learn(const std::vector<Episode *> &episodes)
                     // Copy an existing model
                     _learn_models.push_back(new GaussianMixture(*_models[a]));
                 }
+
+                // The densities of a mixture are computed by the workers. When
+                // several models are trained in parallel, the workers are busy
+                // and each mixture computes its densities alone.
+                _learn_models.back()->setParallelFor([this](unsigned int count, const std::function<void(unsigned int)> &task) {
+                    parallelFor(count, task);
+                });
             }
         }
 
-        // Train the models on this episode
+        // Collect the samples of this episode. The noise is added here, in a
+        // single thread, because the random engine is not thread-safe.
         for (unsigned int t=0; t < episode->length() - 1; ++t) {
-            unsigned int action = episode->action(t);
+            Sample sample;
 
             episode->state(t, state);
             episode->values(t, values);
 
-            vectorToVectorXf(state, input);
+            sample.action = episode->action(t);
+            sample.input.resize(episode->stateSize());
+            sample.output.resize(episode->valueSize());
 
-            if (_mask_actions) {
-                // Update the model of the selected action
-                _learn_models[action]->setValue(input, values[action]);
-            } else {
-                // Update all the models
-                for (unsigned int a=0; a<episode->valueSize(); ++a) {
-                    _learn_models[a]->setValue(input, values[a]);
-                }
+            vectorToVectorXf(state, sample.input);
+
+            for (unsigned int a=0; a<episode->valueSize(); ++a) {
+                sample.output(a) = values[a];
             }
+
+            samples.push_back(sample);
         }
     }
 
+    // The models are independent from each other, train them in parallel
+    parallelFor(_learn_models.size(), [&](unsigned int index) {
+        learnModel(index, samples);
+    });
+
     // Print the number of clusters in the models
     std::cout << "[Gaussian mixture model] Number of clusters:";
 
@@ -137,6 +193,107 @@ void GaussianMixtureModel::learn(const std::vector<Episode *> &episodes)
     std::cout << std::endl;
 }
 
+void GaussianMixtureModel::parallelFor(unsigned int count, const std::function<void(unsigned int)> &task)
+{
+    bool idle = false;
+
+    if (count < 2 || _workers.size() == 0 || !_job_running.compare_exchange_strong(idle, true)) {
+        // Nothing to share, or the workers are busy with another job. This
+        // is also the case of the tasks of a job that call parallelFor().
+        for (unsigned int i=0; i<count; ++i) {
+            task(i);
+        }
+
+        return;
+    }
+
+    // Publish the job, then take tasks as the workers do, and wait for the
+    // tasks taken by the workers.
+    {
+        std::unique_lock<std::mutex> lock(_work_mutex);
+
+        _work_task = &task;
+        _num_tasks = count;
+        _next_task = 0;
+        _pending_tasks = count;
+        _work_generation += 1;
+    }
+
+    _work_cond.notify_all();
+    runTasks();
+
+    {
+        std::unique_lock<std::mutex> lock(_work_mutex);
+
+        _done_cond.wait(lock, [this]() { return _pending_tasks == 0; });
+    }
+
+    _job_running = false;
+}
+
+void GaussianMixtureModel::runTasks()
+{
+    std::unique_lock<std::mutex> lock(_work_mutex);
+
+    while (_next_task < _num_tasks) {
+        unsigned int index = _next_task++;
+        const std::function<void(unsigned int)> &task = *_work_task;
+
+        lock.unlock();
+        task(index);
+        lock.lock();
+
+        if (--_pending_tasks == 0) {
+            _done_cond.notify_all();
+        }
+    }
+}
+
+void GaussianMixtureModel::workerThread()
+{
+    unsigned int generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_work_mutex);
+
+            _work_cond.wait(lock, [&]() { return _finish || _work_generation != generation; });
+
+            if (_finish) {
+                return;
+            }
+
+            generation = _work_generation;
+        }
+
+        runTasks();
+    }
+}
+
+void GaussianMixtureModel::learnModel(unsigned int index, const std::vector<Sample> &samples)
+{
+    GaussianMixture *model = _learn_models[index];
+    unsigned int num_samples = 0;
+
+    for (const Sample &sample : samples) {
+        if (!_mask_actions) {
+            // Update all the values at once
+            model->setValues(sample.input, sample.output);
+        } else if (sample.action == index) {
+            // Update the model of the selected action
+            model->setValue(sample.input, sample.output(index));
+        } else {
+            continue;
+        }
+
+        ++num_samples;
+    }
+
+    // Merge and prune the clusters. As many clusters are examined as samples
+    // have been learned, so that consolidation keeps up with the insertions
+    model->consolidate(_max_clusters, num_samples);
+}
+
 void GaussianMixtureModel::vectorToVectorXf(const std::vector<float> &stl, Eigen::VectorXf &eigen)
 {
     for (std::size_t i=0; i<stl.size(); ++i) {
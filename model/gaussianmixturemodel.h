@@ -28,7 +28,11 @@
 #include <Eigen/Dense>
 #include <vector>
 #include <random>
+#include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
 
 class GaussianMixture;
 
@@ -49,8 +53,11 @@ class GaussianMixtureModel : public AbstractModel
          *              diracs (and vanishing due to rounding errors)
          * @param mask_actions Only learn values associated with the action that
          *                     has been taken, instead of learning all the values.
+         * @param max_clusters Maximum number of clusters per mixture. Overlapping
+         *                     clusters are merged and the least probable ones
+         *                     are dropped after every call to learn().
          */
-        GaussianMixtureModel(float var_initial, float novelty, float noise, bool mask_actions);
+        GaussianMixtureModel(float var_initial, float novelty, float noise, bool mask_actions, unsigned int max_clusters = 2000);
         virtual ~GaussianMixtureModel();
 
         virtual void values(Episode *episode, std::vector<float> &rs);
@@ -58,20 +65,75 @@ class GaussianMixtureModel : public AbstractModel
         virtual void swapModels();
 
     private:
+        struct Sample {
+            Eigen::VectorXf input;
+            Eigen::VectorXf output;
+            unsigned int action;
+        };
+
+        /**
+         * @brief Call @p task(i) for every i in [0, count), on the worker
+         *        threads and the calling thread, and return when all the
+         *        calls have finished.
+         *
+         * values() and learn() may run concurrently. If the workers are
+         * already busy with a job, the tasks are executed by the calling
+         * thread alone.
+         */
+        void parallelFor(unsigned int count, const std::function<void(unsigned int)> &task);
+
+        /**
+         * @brief Execute the tasks of the current job not yet taken by another
+         *        thread, until all of them have been taken.
+         */
+        void runTasks();
+
+        /**
+         * @brief Main loop of a worker thread, that executes tasks every time
+         *        parallelFor() publishes a new job.
+         */
+        void workerThread();
+
+        /**
+         * @brief Train one of the learning models on the samples that concern it.
+         *
+         * The models are independent, so this method can be called concurrently
+         * for different values of @p index.
+         */
+        void learnModel(unsigned int index, const std::vector<Sample> &samples);
+
         void vectorToVectorXf(const std::vector<float> &stl, Eigen::VectorXf &eigen);
 
     private:
         float _var_initial;
         float _novelty;
         bool _mask_actions;
+        unsigned int _max_clusters;
 
         std::normal_distribution<float> _noise_distribution;
         std::default_random_engine _random_engine;
 
-        std::vector<GaussianMixture *> _models;     /*!< @brief One model per action */
+        std::vector<GaussianMixture *> _models;     /*!< @brief One model per action, or a single multi-output model if actions are not masked */
         std::vector<GaussianMixture *> _learn_models;
 
         std::mutex _models_mutex;
+
+        // The worker threads are created by the constructor and kept until
+        // the model is destroyed. They train the models in parallel when
+        // actions are masked, and share the density computations of a single
+        // mixture otherwise. The following members are protected by
+        // _work_mutex.
+        std::vector<std::thread> _workers;
+        std::atomic<bool> _job_running;             /*!< @brief Set by the thread whose job the workers execute */
+        std::mutex _work_mutex;
+        std::condition_variable _work_cond;         /*!< @brief Signaled when a new job is published or the workers have to finish */
+        std::condition_variable _done_cond;         /*!< @brief Signaled when all the tasks of the job have been executed */
+        const std::function<void(unsigned int)> *_work_task;   /*!< @brief Task executed by the current job */
+        unsigned int _work_generation;              /*!< @brief Incremented every time a job is published */
+        unsigned int _num_tasks;                    /*!< @brief Number of tasks in the current job */
+        unsigned int _next_task;                    /*!< @brief Next task to be taken by a thread */
+        unsigned int _pending_tasks;                /*!< @brief Number of tasks not yet finished */
+        bool _finish;
 };
 
 #endif
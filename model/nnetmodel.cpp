@@ -25,9 +25,12 @@
 
 #include <nnetcpp/networkserializer.h>
 
-NnetModel::NnetModel()
+NnetModel::NnetModel(unsigned int target_refresh)
 : _network(nullptr),
-  _learn_network(nullptr)
+  _learn_network(nullptr),
+  _target_network(nullptr),
+  _target_refresh(target_refresh),
+  _learn_count(0)
 {
 }
 
@@ -40,6 +43,10 @@ NnetModel::~NnetModel()
     if (_learn_network) {
         delete _learn_network;
     }
+
+    if (_target_network) {
+        delete _target_network;
+    }
 }
 
 void NnetModel::swapModels()
@@ -52,27 +59,23 @@ void NnetModel::swapModels()
 
 void NnetModel::values(Episode *episode, std::vector<float> &rs)
 {
-    if (!_network) {
-        // No model available, clear out rs
-        rs.resize(episode->valueSize());
-        std::fill(rs.begin(), rs.end(), 0.0f);
-    } else {
-        // Convert the last state to an Eigen vector
-        Vector last_state;
+    std::unique_lock<std::mutex> lock(_mutex);
 
-        episode->encodedState(episode->length() - 1, rs);
-        vectorToVector(rs, last_state);
+    predict(_network, episode, rs);
+}
+
+bool NnetModel::targetValues(Episode *episode, std::vector<float> &rs)
+{
+    if (_target_refresh == 0) {
+        return false;
+    }
 
-        // Feed this input to the network
-        std::unique_lock<std::mutex> lock(_mutex);
-        Vector prediction = _network->predict(last_state);
+    std::unique_lock<std::mutex> lock(_mutex);
 
-        rs.resize(episode->valueSize());
+    // Until the first refresh, the target network is the prediction network
+    predict(_target_network ? _target_network : _network, episode, rs);
 
-        for (std::size_t i=0; i<rs.size(); ++i) {
-            rs[i] = prediction(i);
-        }
-    }
+    return true;
 }
 
 void NnetModel::learn(const std::vector<Episode *> &episodes)
@@ -93,6 +96,30 @@ void NnetModel::learn(const std::vector<Episode *> &episodes)
         _learn_network->deserialize(serializer);
     }
 
+    // Refresh the target network with the weights of the latest network. The
+    // target network is created once, and its weights are then overwritten.
+    // swapModels() is never called during learn(), and values() does not
+    // modify the weights of _network, so it is read without locking.
+    if (_target_refresh != 0 && _network && ++_learn_count >= _target_refresh) {
+        NetworkSerializer serializer;
+        Network *target_network = _target_network;
+
+        if (!target_network) {
+            target_network = createNetwork(episodes[0]);
+        }
+
+        _network->serialize(serializer);
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            target_network->deserialize(serializer);
+            _target_network = target_network;
+        }
+
+        _learn_count = 0;
+    }
+
     // Create a big matrix with one column per input/output pair
     std::size_t total_size = 0;
 
@@ -123,6 +150,31 @@ void NnetModel::learn(const std::vector<Episode *> &episodes)
     _learn_network->train(inputs, outputs, 10, 4);
 }
 
+void NnetModel::predict(Network *network, Episode *episode, std::vector<float> &rs)
+{
+    if (!network) {
+        // No model available, clear out rs
+        rs.resize(episode->valueSize());
+        std::fill(rs.begin(), rs.end(), 0.0f);
+    } else {
+        // Convert the last state to an Eigen vector
+        Vector last_state;
+
+        episode->encodedState(episode->length() - 1, rs);
+        vectorToVector(rs, last_state);
+
+        // Feed this input to the network. The caller holds _mutex, so that
+        // the network cannot be swapped during the prediction.
+        Vector prediction = network->predict(last_state);
+
+        rs.resize(episode->valueSize());
+
+        for (std::size_t i=0; i<rs.size(); ++i) {
+            rs[i] = prediction(i);
+        }
+    }
+}
+
 void NnetModel::vectorToVector(const std::vector<float> &stl, Vector &eigen)
 {
     eigen.resize(stl.size());
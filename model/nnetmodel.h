@@ -35,14 +35,24 @@
  * any history. This hypothesis is valid when a neural network has no recurrence,
  * but recurrent networks require histories to be kept in order (use
  * RecurrentNnetModel for that).
+ *
+ * A target network can be enabled, that is refreshed every few calls to
+ * learn() and used by targetValues() to provide stable values towards which
+ * learning algorithms bootstrap.
  */
 class NnetModel : public AbstractModel
 {
     public:
-        NnetModel();
+        /**
+         * @param target_refresh Number of calls to learn() between two refreshes
+         *                       of the target network. 0 disables the target
+         *                       network.
+         */
+        NnetModel(unsigned int target_refresh = 0);
         virtual ~NnetModel();
 
         virtual void values(Episode *episode, std::vector<float> &rs);
+        virtual bool targetValues(Episode *episode, std::vector<float> &rs);
         virtual void learn(const std::vector<Episode *> &episodes);
         virtual void swapModels();
 
@@ -56,9 +66,21 @@ class NnetModel : public AbstractModel
         static void vectorToCol(const std::vector<float> &stl, Matrix &matrix, int col);
         static void getNodeOutput(AbstractNode *node, std::vector<float> &rs);
 
+    private:
+        /**
+         * @brief Predict the values of the last state of @p episode with @p network
+         *
+         * @note _mutex must be held by the caller
+         */
+        static void predict(Network *network, Episode *episode, std::vector<float> &rs);
+
     private:
         Network *_network;
         Network *_learn_network;
+        Network *_target_network;       /*!< @brief Frozen network used by targetValues(), nullptr until the first refresh */
+
+        unsigned int _target_refresh;
+        unsigned int _learn_count;      /*!< @brief Number of calls to learn() since the last refresh of the target network */
 
         std::mutex _mutex;
 };
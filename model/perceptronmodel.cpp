@@ -26,8 +26,9 @@
 #include <nnetcpp/dense.h>
 #include <nnetcpp/activation.h>
 
-PerceptronModel::PerceptronModel(unsigned int hidden_neurons)
-: _hidden_neurons(hidden_neurons)
+PerceptronModel::PerceptronModel(unsigned int hidden_neurons, unsigned int target_refresh)
+: NnetModel(target_refresh),
+  _hidden_neurons(hidden_neurons)
 {
 }
 
@@ -37,8 +37,10 @@ class PerceptronModel : public NnetModel
          * @brief Constructor.
          *
          * @param hidden_neurons Number of neurons in the hidden layers
+         * @param target_refresh Number of calls to learn() between two refreshes
+         *                       of the target network, 0 for no target network
          */
-        PerceptronModel(unsigned int hidden_neurons);
+        PerceptronModel(unsigned int hidden_neurons, unsigned int target_refresh = 0);
 
         virtual Network *createNetwork(Episode *first_episode) const;
 
@@ -23,11 +23,18 @@
 #include "psrmodel.h"
 #include "nnetmodel.h"
 #include "episode.h"
+#include "random.h"
 
+#include <algorithm>
 #include <iostream>
 #include <random>
 #include <cmath>
 
+/**
+ * @brief Maximum number of samples learned by the PSR in one block
+ */
+static const unsigned int max_block_size = 32;
+
 PSRModel::PSRModel(unsigned int history_length,
                    unsigned int test_length,
                    unsigned int rank,
@@ -37,8 +44,26 @@ PSRModel::PSRModel(unsigned int history_length,
   _rank(rank),
   _random_features(random_features),
   _psr(nullptr),
+  _learning_psr(nullptr),
+  _swapped(false),
   _last_episode(nullptr)
 {
+    // The values tried by valueOfAction() are always the same, encode them once
+    Eigen::VectorXf encoded(_random_features);
+    Eigen::VectorXf eigen(1);
+
+    for (float v=-10.0f; v<20.0f; v+=0.1f) {
+        _candidate_values.push_back(v);
+    }
+
+    _candidate_features.resize(_candidate_values.size(), _random_features);
+
+    for (std::size_t i=0; i<_candidate_values.size(); ++i) {
+        eigen(0) = _candidate_values[i];
+        encodeVector(encoded, 0, eigen);
+
+        _candidate_features.row(i) = encoded.transpose();
+    }
 }
 
 PSRModel::~PSRModel()
@@ -46,11 +71,21 @@ PSRModel::~PSRModel()
     if (_psr) {
         delete _psr;
     }
+
+    if (_learning_psr) {
+        delete _learning_psr;
+    }
 }
 
 void PSRModel::swapModels()
 {
-    // TODO
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // Publish the learned PSR. Its belief has not followed the current
+    // episode, so make values() replay the episode from its beginning.
+    std::swap(_psr, _learning_psr);
+    _swapped = true;
+    _last_episode = nullptr;
 }
 
 void PSRModel::values(Episode *episode, std::vector<float> &rs)
@@ -61,65 +96,63 @@ void PSRModel::values(Episode *episode, std::vector<float> &rs)
         // No model available, clear out rs
         std::fill(rs.begin(), rs.end(), 0.0f);
     } else {
+        std::unique_lock<std::mutex> lock(_mutex);
+
         // Reset the PSR model if needed
         if (episode != _last_episode || _last_episode_length >= episode->length()) {
-            _last_episode_length = 0;
+            _last_episode_length = 1;
             _psr->reset();
         }
 
+        // Update PSR with the action-observation-values of the time-steps
+        // that it has not yet seen (only the last one, unless the PSR has
+        // just been reset)
+        for (unsigned int t=_last_episode_length-1; t+1<episode->length(); ++t) {
+            _psr->update(makeSequence(episode, t, t+1));
+        }
+
         _last_episode_length = episode->length();
         _last_episode = episode;
 
-        // Update PSR with the action-observation-values of the last time-step
-        if (episode->length() > 1) {
-            _psr->update(
-                makeSequence(episode, episode->length()-2, episode->length()-1)
-            );
-        }
+        // The prediction of the PSR is linear in the action-observation, and
+        // the state part of it is the same for all the actions
+        Eigen::VectorXf ao(_random_features);
+        Eigen::VectorXf eigen;
+        std::vector<float> state;
+
+        _psr->predictionWeights(_weights);
+
+        episode->state(episode->length()-1, state);
+        NnetModel::vectorToVector(state, eigen);
+        encodeVector(ao, 0, eigen);
+
+        float state_proba = _weights.head(_random_features).dot(ao);
 
         // episode[-1] contains a state, but no action nor value yet. Try all the
         // actions to get the values
         for (unsigned int a=0; a<episode->valueSize(); ++a) {
-            rs[a] = valueOfAction(episode, a);
+            rs[a] = valueOfAction(_weights, state_proba, a);
         }
     }
 }
 
-float PSRModel::valueOfAction(Episode *episode, unsigned int action)
+float PSRModel::valueOfAction(const Eigen::VectorXf &weights, float state_proba, unsigned int action)
 {
-    Eigen::VectorXf ao(3 * _random_features);
-    Eigen::VectorXf eigen;
-    std::vector<float> state;
-
-    episode->state(episode->length()-1, state);
-    NnetModel::vectorToVector(state, eigen);
-
-    // Encode the current state and action in the action-observation pair
-    encodeVector(ao, 0*_random_features, eigen);
+    Eigen::VectorXf ao(_random_features);
+    Eigen::VectorXf eigen(1);
 
-    eigen.resize(1);
+    // Encode the action
     eigen(0) = float(action);
+    encodeVector(ao, 0, eigen);
 
-    encodeVector(ao, 1*_random_features, eigen);
+    float proba = state_proba + weights.segment(1*_random_features, _random_features).dot(ao);
 
-    // Try different values
-    float rs = 0.0f;
-    float max_proba = -100.0f;
+    // Predict the probability of all the candidate values at once, and keep
+    // the most probable one
+    unsigned int best_value;
+    float max_proba = proba + (_candidate_features * weights.segment(2*_random_features, _random_features)).maxCoeff(&best_value);
 
-    for (float v=-10.0f; v<20.0f; v+=0.1f) {
-        eigen(0) = v;
-        encodeVector(ao, 2*_random_features, eigen);
-
-        // Predict the probability of this value
-        float proba = _psr->predict(ao);
-
-        if (proba > max_proba) {
-            rs = v;
-            max_proba = proba;
-        }
-    }
-
-    return rs;
+    return (max_proba > -100.0f ? _candidate_values[best_value] : 0.0f);
 }
 
 void PSRModel::learn(const std::vector<Episode *> &episodes)
@@ -127,25 +160,68 @@ void PSRModel::learn(const std::vector<Episode *> &episodes)
     unsigned int ao_length = 3 * _random_features;  // action, observation, values
 
     // Create the model if needed
-    if (!_psr) {
-        _psr = new PSR(_history_length * ao_length, ao_length, _test_length * ao_length, _rank);
+    if (!_psr && !_learning_psr) {
+        _learning_psr = new PSR(_history_length * ao_length, ao_length, _test_length * ao_length, _rank);
 
         // Create random features for the state
         _features.reserve(_random_features);
 
+        Random &random = Random::local();
+
         for (unsigned int i=0; i<_random_features; ++i) {
-            _features.push_back(Eigen::VectorXf::Random(episodes[0]->stateSize()) * 10.0f);
+            Eigen::VectorXf feature(episodes[0]->stateSize());
+
+            for (int j=0; j<feature.rows(); ++j) {
+                feature(j) = (random.uniform() * 2.0f - 1.0f) * 10.0f;
+            }
+
+            _features.push_back(feature);
         }
+    } else if (_swapped) {
+        // Continue learning from the latest PSR. values() only modifies its
+        // belief, not its parameters, so they are copied without locking.
+        // When no swap happened, _learning_psr already contains the latest
+        // parameters and is simply trained further.
+        if (!_learning_psr) {
+            _learning_psr = new PSR(_history_length * ao_length, ao_length, _test_length * ao_length, _rank);
+        }
+
+        _learning_psr->copyParameters(*_psr);
     }
 
-    // Create histories, action-observations and tests for all the episodes
+    _swapped = false;
+
+    // Create histories, action-observations and tests for all the episodes.
+    // The samples of an episode are given to the PSR in blocks, each block
+    // being learned with a single update of the spectral decomposition.
+    Eigen::MatrixXf histories;
+    Eigen::MatrixXf aos;
+    Eigen::MatrixXf futures;
+
     for (Episode *episode : episodes) {
-        for (unsigned int t=_history_length; t<episode->length()-_test_length-1; ++t) {
-            _psr->train(
-                makeSequence(episode, t-_history_length, t),
-                makeSequence(episode, t, t+1),
-                makeSequence(episode, t+1, t+_test_length+1)
-            );
+        if (episode->length() < _history_length + _test_length + 2) {
+            // Too short to contain a complete sample
+            continue;
+        }
+
+        unsigned int end = episode->length() - _test_length - 1;
+
+        for (unsigned int from=_history_length; from<end; from+=max_block_size) {
+            unsigned int block_size = std::min(max_block_size, end - from);
+
+            histories.resize(_history_length * ao_length, block_size);
+            aos.resize(ao_length, block_size);
+            futures.resize(_test_length * ao_length, block_size);
+
+            for (unsigned int i=0; i<block_size; ++i) {
+                unsigned int t = from + i;
+
+                histories.col(i) = makeSequence(episode, t-_history_length, t);
+                aos.col(i) = makeSequence(episode, t, t+1);
+                futures.col(i) = makeSequence(episode, t+1, t+_test_length+1);
+            }
+
+            _learning_psr->train(histories, aos, futures);
         }
     }
 }
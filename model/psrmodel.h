@@ -89,8 +89,12 @@ class PSRModel : public AbstractModel
 
         /**
          * @brief Return the value of an action given the current state of PSR
+         *
+         * @param weights Prediction weights of the PSR, see PSR::predictionWeights()
+         * @param state_proba Contribution of the encoded state to the prediction
+         * @param action Action whose value is returned
          */
-        float valueOfAction(Episode *episode, unsigned int action);
+        float valueOfAction(const Eigen::VectorXf &weights, float state_proba, unsigned int action);
 
     private:
         std::mutex _mutex;
@@ -100,12 +104,18 @@ class PSRModel : public AbstractModel
         unsigned int _rank;
         unsigned int _random_features;
 
-        PSR * _psr;
+        PSR *_psr;                      /*!< @brief PSR used by values() */
+        PSR *_learning_psr;             /*!< @brief PSR trained by learn(), swapped with _psr by swapModels() */
+        bool _swapped;                  /*!< @brief swapModels() has been called since the last learn(), _learning_psr is out of date */
 
         unsigned int _last_episode_length;
         Episode *_last_episode;
 
         std::vector<Eigen::VectorXf> _features;
+
+        std::vector<float> _candidate_values;   /*!< @brief Values tried by valueOfAction() */
+        Eigen::MatrixXf _candidate_features;    /*!< @brief Encoding of every candidate value, one per row */
+        Eigen::VectorXf _weights;               /*!< @brief Prediction weights of the PSR, computed once per call to values() */
 };
 
 #endif
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2015 Vrije Universiteit Brussel
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "random.h"
+
+#include <atomic>
+
+static std::atomic<uint64_t> global_seed(0x853c49e6748fea9bULL);
+static std::atomic<uint64_t> next_stream(0);
+
+/**
+ * @brief First stream given to the threads that never called seedLocal(),
+ *        so that they do not share a stream with the ones that did
+ */
+static const uint64_t automatic_streams = 1ULL << 32;
+
+Random::Random(uint64_t seed, uint64_t stream)
+{
+    this->seed(seed, stream);
+}
+
+void Random::seed(uint64_t seed, uint64_t stream)
+{
+    // Initialization procedure of the reference PCG32 implementation
+    _state = 0;
+    _increment = (stream << 1) | 1;
+
+    next();
+    _state += seed;
+    next();
+}
+
+uint32_t Random::next()
+{
+    uint64_t old_state = _state;
+
+    // Advance the internal LCG, then permute its old state to produce the output
+    _state = old_state * 6364136223846793005ULL + _increment;
+
+    uint32_t xorshifted = ((old_state >> 18) ^ old_state) >> 27;
+    uint32_t rot = old_state >> 59;
+
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+float Random::uniform()
+{
+    // 24 random bits fill the mantissa of a float
+    return float(next() >> 8) * (1.0f / 16777216.0f);
+}
+
+unsigned int Random::uniform(unsigned int n)
+{
+    return (uint64_t(next()) * n) >> 32;
+}
+
+unsigned int Random::sample(const std::vector<float> &probabilities)
+{
+    float rnd = uniform();
+    float acc = 0.0f;
+    unsigned int last = probabilities.size() - 1;
+
+    for (unsigned int i=0; i<last; ++i) {
+        acc += probabilities[i];
+
+        if (acc > rnd) {
+            return i;
+        }
+    }
+
+    return last;
+}
+
+Random &Random::local()
+{
+    thread_local Random random(global_seed, automatic_streams + next_stream++);
+
+    return random;
+}
+
+void Random::setSeed(uint64_t seed)
+{
+    global_seed = seed;
+    next_stream = 0;
+
+    seedLocal(0);
+}
+
+void Random::seedLocal(uint64_t stream)
+{
+    local().seed(global_seed, stream);
+}
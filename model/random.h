@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2015 Vrije Universiteit Brussel
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __RANDOM_H__
+#define __RANDOM_H__
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Small and fast pseudo-random number generator (PCG32)
+ *
+ * Unlike std::rand(), a Random object has no global state and no lock, so
+ * every thread can use its own generator (see Random::local()). Generators
+ * created with the same seed and stream produce the same numbers.
+ *
+ * O'Neill, PCG: A Family of Simple Fast Space-Efficient Statistically Good
+ * Algorithms for Random Number Generation, 2014
+ */
+class Random
+{
+    public:
+        /**
+         * @param seed Initial state of the generator
+         * @param stream Index of the sequence of numbers produced by this
+         *               generator. Generators having the same seed but
+         *               different streams produce independent sequences.
+         */
+        Random(uint64_t seed, uint64_t stream = 0);
+
+        /**
+         * @brief Reset the generator, as if it was constructed with @p seed
+         *        and @p stream
+         */
+        void seed(uint64_t seed, uint64_t stream = 0);
+
+        /**
+         * @brief Uniformly-distributed 32-bit integer
+         */
+        uint32_t next();
+
+        /**
+         * @brief Uniformly-distributed float in [0, 1)
+         */
+        float uniform();
+
+        /**
+         * @brief Uniformly-distributed integer in [0, @p n)
+         */
+        unsigned int uniform(unsigned int n);
+
+        /**
+         * @brief Index of an element of @p probabilities, chosen with the
+         *        probability given by the element
+         *
+         * The probabilities must sum to one. The last element absorbs any
+         * rounding error.
+         */
+        unsigned int sample(const std::vector<float> &probabilities);
+
+        /**
+         * @brief Generator of the calling thread
+         *
+         * Each thread has its own generator, seeded with the seed given to
+         * setSeed(). Its stream is the one given to seedLocal() or, if the
+         * thread never called it, depends on the order in which the threads
+         * first call this method.
+         */
+        static Random &local();
+
+        /**
+         * @brief Set the global seed, and reseed the generator of the calling
+         *        thread with it and stream 0.
+         *
+         * This must be called before any other thread uses local() for runs
+         * to be reproducible.
+         */
+        static void setSeed(uint64_t seed);
+
+        /**
+         * @brief Reseed the generator of the calling thread with the global
+         *        seed and a given stream.
+         *
+         * Threads that are created in a non-deterministic order call this when
+         * they start, with a stream unique to their role, so that they draw
+         * the same numbers from one run to another.
+         */
+        static void seedLocal(uint64_t stream);
+
+    private:
+        uint64_t _state;
+        uint64_t _increment;
+};
+
+#endif
@@ -65,6 +65,11 @@ void DynaModel::values(Episode *episode, std::vector<float> &rs)
     _model->values(episode, rs);
 }
 
+bool DynaModel::targetValues(Episode *episode, std::vector<float> &rs)
+{
+    return _model->targetValues(episode, rs);
+}
+
 void DynaModel::valuesForPlotting(Episode *episode, std::vector<float> &rs)
 {
     _model->valuesForPlotting(episode, rs);
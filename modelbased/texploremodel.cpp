@@ -24,6 +24,7 @@
 #include "modelworld.h"
 
 #include "model/episode.h"
+#include "model/random.h"
 
 #include <atomic>
 #include <unistd.h>
@@ -73,6 +74,9 @@ TEXPLOREModel::~TEXPLOREModel()
 
 void TEXPLOREModel::updateWorldThread()
 {
+    // Each thread draws from its own stream of random numbers
+    Random::seedLocal(1);
+
     std::vector<Episode *> episodes(1);
 
     while (true) {
@@ -109,6 +113,9 @@ void TEXPLOREModel::updateWorldThread()
 
 void TEXPLOREModel::updateModelThread()
 {
+    // Each thread draws from its own stream of random numbers
+    Random::seedLocal(2);
+
     std::vector<Episode *> episodes;
 
     // Perform rollouts until the thread has to end
@@ -163,6 +170,11 @@ void TEXPLOREModel::values(Episode *episode, std::vector<float> &rs)
     }
 }
 
+bool TEXPLOREModel::targetValues(Episode *episode, std::vector<float> &rs)
+{
+    return _model->targetValues(episode, rs);
+}
+
 void TEXPLOREModel::valuesForPlotting(Episode *episode, std::vector<float> &rs)
 {
     // Tell the threads to exit, no more rollouts are needed. This reduces contention
@@ -57,6 +57,7 @@ class TEXPLOREModel : public AbstractModel
 
         virtual void values(Episode *episode, std::vector<float> &rs);
         virtual void valuesForPlotting(Episode *episode, std::vector<float> &rs);
+        virtual bool targetValues(Episode *episode, std::vector<float> &rs);
         virtual void learn(const std::vector<Episode *> &episodes);
         virtual void swapModels();
 
@@ -23,6 +23,7 @@
 #include "abstractworld.h"
 
 #include <learning/abstractlearning.h>
+#include <model/random.h>
 #include <model/abstractmodel.h>
 #include <model/episode.h>
 
@@ -48,6 +49,20 @@ static void sigterm_handler(int)
     abort_run = true;
 }
 
+/**
+ * @brief Add to @p episode the values (and target values) predicted by @p model
+ *        for its last state
+ */
+static void addValues(AbstractModel *model, Episode *episode, std::vector<float> &values)
+{
+    model->values(episode, values);
+    episode->addValues(values);
+
+    if (model->targetValues(episode, values)) {
+        episode->addTargetValues(values);
+    }
+}
+
 AbstractWorld::AbstractWorld(unsigned int num_actions)
 : _num_actions(num_actions)
 {
@@ -90,12 +105,18 @@ std::vector<Episode *> AbstractWorld::run(AbstractModel *model,
                                           unsigned int batch_size,
                                           Episode::Encoder encoder,
                                           bool verbose,
-                                          Episode *start_episode)
+                                          Episode *start_episode,
+                                          std::vector<Follower> *followers)
 {
     std::vector<Episode *> episodes;
     std::vector<Episode *> learn_episodes;
     std::vector<float> state;
     std::vector<float> values;
+    std::vector<float> follower_values;
+
+    if (start_episode) {
+        followers = nullptr;
+    }
 
     for (unsigned int e=0; e<num_episodes && !abort_run; ++e) {
         Episode *episode;
@@ -109,6 +130,15 @@ std::vector<Episode *> AbstractWorld::run(AbstractModel *model,
             updateMinMax(state);
 
             episode->addState(state);
+
+            if (followers) {
+                for (Follower &follower : *followers) {
+                    Episode *follower_episode = new Episode(follower.learning->valueSize(_num_actions), _num_actions, encoder);
+
+                    follower_episode->addState(state);
+                    follower.episodes.push_back(follower_episode);
+                }
+            }
         } else {
             // Copy the existing episode and replay its action in the world
             episode = new Episode(*start_episode);
@@ -122,41 +152,53 @@ std::vector<Episode *> AbstractWorld::run(AbstractModel *model,
         }
 
         // Initial value
-        model->values(episode, values);
-        episode->addValues(values);
+        addValues(model, episode, values);
+
+        if (followers) {
+            for (Follower &follower : *followers) {
+                addValues(follower.model, follower.episodes.back(), follower_values);
+            }
+        }
 
         // Perform the steps
         unsigned int steps = 0;
         bool finished = false;
         float reward;
         float td_error;
+        float follower_td_error;        // The followers must not overwrite td_error of learning
 
         while (steps < max_episode_length && !finished && !abort_run) {
             learning->actions(episode, values, td_error);
 
             // Choose an action according to the probabilities
-            float rnd = float(std::rand() % 65536) / 65536.0f;
-            float acc = 0.0f;
-            unsigned int action;
-
-            for (action = 0; action < episode->valueSize() - 1; ++action) {
-                acc += values[action];
-
-                if (acc > rnd) {
-                    break;
-                }
-            }
+            unsigned int action = learning->chooseAction(values);
+            float probability = values[action];
 
             // Carry out the action
             step(action, finished, reward, state);
             updateMinMax(state);
 
-            episode->addAction(action);
+            episode->addAction(action, probability);
             episode->addReward(reward);
             episode->addState(state);
 
-            model->values(episode, values);
-            episode->addValues(values);
+            if (followers) {
+                // The followers learn from the action chosen by learning,
+                // whatever the action they would have chosen
+                for (Follower &follower : *followers) {
+                    Episode *follower_episode = follower.episodes.back();
+
+                    follower.learning->actions(follower_episode, follower_values, follower_td_error);
+
+                    follower_episode->addAction(action, probability);
+                    follower_episode->addReward(reward);
+                    follower_episode->addState(state);
+
+                    addValues(follower.model, follower_episode, follower_values);
+                }
+            }
+
+            addValues(model, episode, values);
 
             steps++;
         }
@@ -167,6 +209,15 @@ std::vector<Episode *> AbstractWorld::run(AbstractModel *model,
         // Tell the episode whether it has been aborted or has reached the goal
         episode->setAborted(!finished);
 
+        if (followers) {
+            for (Follower &follower : *followers) {
+                Episode *follower_episode = follower.episodes.back();
+
+                follower.learning->actions(follower_episode, follower_values, follower_td_error);
+                follower_episode->setAborted(!finished);
+            }
+        }
+
         // If a batch has been finished, update the model and "swap" it
         episodes.push_back(episode);
         learn_episodes.push_back(episode);
@@ -176,8 +227,30 @@ std::vector<Episode *> AbstractWorld::run(AbstractModel *model,
         if (learn_episodes.size() == batch_size) {
             if (verbose) std::cout << "Learning..." << std::flush;
 
+            for (Episode *learn_episode : learn_episodes) {
+                learning->finishEpisode(learn_episode);
+            }
+
             model->learn(learn_episodes);
             model->swapModels();
+
+            if (followers) {
+                // The last episodes of every follower correspond to learn_episodes
+                for (Follower &follower : *followers) {
+                    std::vector<Episode *> follower_episodes(
+                        follower.episodes.end() - learn_episodes.size(),
+                        follower.episodes.end()
+                    );
+
+                    for (Episode *follower_episode : follower_episodes) {
+                        follower.learning->finishEpisode(follower_episode);
+                    }
+
+                    follower.model->learn(follower_episodes);
+                    follower.model->swapModels();
+                }
+            }
+
             learn_episodes.clear();
 
             if (verbose) std::cout << "done" << std::endl;
@@ -36,6 +36,20 @@ class AbstractLearning;
 class AbstractWorld
 {
     public:
+        /**
+         * @brief Model and learning algorithm that learn off-policy from the
+         *        episodes of another agent
+         *
+         * Followers allow several configurations to learn from a single
+         * simulation of the world. They observe the states, actions and rewards
+         * of the agent run by run(), but never choose actions.
+         */
+        struct Follower {
+            AbstractModel *model;
+            AbstractLearning *learning;
+            std::vector<Episode *> episodes;    /*!< @brief Episodes seen by this follower, filled by run(). The caller must delete them. */
+        };
+
         AbstractWorld(unsigned int num_actions);
         virtual ~AbstractWorld() {}
 
@@ -104,6 +118,11 @@ class AbstractWorld
          * @param start_episode if not null, this episode is replayed before any
          *                      new episode. This allows to simulate a world from
          *                      a starting position (with history taken into account)
+         * @param followers If not null, models and learning algorithms that
+         *                  learn from the episodes of @p learning, in addition
+         *                  to @p model. Each follower has its own episodes,
+         *                  with its own values. Ignored if @p start_episode
+         *                  is not null.
          *
          * @return A list of episodes. The caller must delete the episodes.
          */
@@ -114,7 +133,8 @@ class AbstractWorld
                                    unsigned int batch_size,
                                    Episode::Encoder encoder,
                                    bool verbose = true,
-                                   Episode *start_episode = nullptr);
+                                   Episode *start_episode = nullptr,
+                                   std::vector<Follower> *followers = nullptr);
 
     private:
         /**
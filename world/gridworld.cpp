@@ -22,6 +22,8 @@
 
 #include "gridworld.h"
 
+#include <model/random.h>
+
 #include <cstdlib>
 
 GridWorld::GridWorld(unsigned int width,
@@ -50,8 +52,8 @@ void GridWorld::reset()
 {
     if (_stochastic) {
         // For the next episode, the initial position is moved
-        _initial.x = std::rand() % _width;
-        _initial.y = std::rand() % _height;
+        _initial.x = Random::local().uniform(_width);
+        _initial.y = Random::local().uniform(_height);
     }
 
     _current_pos = _initial;
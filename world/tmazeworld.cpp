@@ -22,6 +22,8 @@
 
 #include "tmazeworld.h"
 
+#include <model/random.h>
+
 #include <cstdlib>
 
 TMazeWorld::TMazeWorld(unsigned int length,
@@ -45,7 +47,7 @@ void TMazeWorld::reset()
     _pos = 0;
 
     // Choose a target
-    if (std::rand() & 1) {
+    if (Random::local().uniform(2) == 1) {
         _target = Action::Up;
     } else {
         _target = Action::Down;